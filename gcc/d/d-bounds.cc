@@ -0,0 +1,789 @@
+// d-bounds.cc -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+// Removal of array bounds checks that can be proven redundant.
+//
+// An index is known to be in bounds if:
+//  - the frontend says so, as for the element read by a foreach over an array;
+//  - its value range, from dfrontend/intrange.c, fits in a static array;
+//  - it is the variable of an enclosing loop such as
+//	for (; i < a.length; ++i)	or	foreach (i; 0 .. a.length)
+//    and neither i nor a can change in the loop body.
+//
+// For the last, Statement::boundsScan collects the variables assigned in the
+// loop body, and the variables of the function that may be changed through
+// a pointer or reference.  Anything it can't look into, such as inline
+// assembler, makes it give up.
+
+#include "d-gcc-includes.h"
+#include "d-lang.h"
+#include "d-codegen.h"
+
+#include "init.h"
+#include "intrange.h"
+
+/* Print where a bounds check was kept or removed, and why, with
+   -fbounds-check-report.  */
+
+static void
+bounds_report (Loc loc, Expression *e, bool kept, const char *reason)
+{
+  if (!gen.reportBoundsChecks)
+    return;
+
+  fprintf (stderr, "%s: bounds check on %s %s: %s\n", loc.toChars(),
+	   e->toChars(), kept ? "kept" : "removed", reason);
+}
+
+/* Return E without the integral casts that keep its value, assuming it
+   is not negative.  If NARROW, also look through casts to smaller unsigned
+   types, which can only make the value smaller.  */
+
+static Expression *
+bounds_strip (Expression *e, bool narrow)
+{
+  while (e->op == TOKcast && e->type->isintegral()
+	 && ((CastExp *) e)->e1->type->isintegral())
+    {
+      Type *from = ((CastExp *) e)->e1->type;
+      bool signed_p = !e->type->isunsigned();
+
+      if (e->type->size() < from->size() ? (!narrow || signed_p)
+	  : (e->type->size() == from->size() && signed_p && from->isunsigned()))
+	break;
+      e = ((CastExp *) e)->e1;
+    }
+  return e;
+}
+
+/* Return the variable E refers to, or NULL.  */
+
+static VarDeclaration *
+bounds_var (Expression *e)
+{
+  e = bounds_strip (e, true);
+  if (e->op == TOKvar)
+    return ((VarExp *) e)->var->isVarDeclaration();
+
+  return NULL;
+}
+
+/* Return the value V is initialized with, or NULL.  */
+
+static Expression *
+bounds_init (VarDeclaration *v)
+{
+  ExpInitializer *ie = v->init ? v->init->isExpInitializer() : NULL;
+  if (!ie)
+    return NULL;
+
+  Expression *e = ie->exp;
+  if (e->op == TOKconstruct || e->op == TOKblit)
+    e = ((AssignExp *) e)->e2;
+  return e;
+}
+
+/* Return the variables whose storage E is part of.  */
+
+static void
+bounds_lvalue (Expression *e, VarDeclarations *vars)
+{
+  switch (e->op)
+    {
+    case TOKvar:
+      if (((VarExp *) e)->var->isVarDeclaration())
+	vars->push (((VarExp *) e)->var->isVarDeclaration());
+      break;
+
+    case TOKsymoff:
+      if (((SymOffExp *) e)->var->isVarDeclaration())
+	vars->push (((SymOffExp *) e)->var->isVarDeclaration());
+      break;
+
+    case TOKindex:
+      // Elements of a dynamic array, or of what a pointer points to, are
+      // not part of any variable we care about.
+      if (((IndexExp *) e)->e1->type->toBasetype()->ty == Tsarray)
+	bounds_lvalue (((IndexExp *) e)->e1, vars);
+      break;
+
+    case TOKslice:
+      if (((SliceExp *) e)->e1->type->toBasetype()->ty == Tsarray)
+	bounds_lvalue (((SliceExp *) e)->e1, vars);
+      break;
+
+    case TOKdotvar:
+      if (((DotVarExp *) e)->e1->type->toBasetype()->ty == Tstruct)
+	bounds_lvalue (((DotVarExp *) e)->e1, vars);
+      break;
+
+    case TOKcast:
+    case TOKarraylength:
+      bounds_lvalue (((UnaExp *) e)->e1, vars);
+      break;
+
+    case TOKcomma:
+      bounds_lvalue (((CommaExp *) e)->e2, vars);
+      break;
+
+    case TOKquestion:
+      bounds_lvalue (((CondExp *) e)->e1, vars);
+      bounds_lvalue (((CondExp *) e)->e2, vars);
+      break;
+
+    default:
+      break;
+    }
+}
+
+/* Called by Expression::apply on each node E of the expression
+   given to BoundsScan::scan.  */
+
+static int
+bounds_scan_exp (Expression *e, void *param)
+{
+  BoundsScan *bs = (BoundsScan *) param;
+
+  switch (e->op)
+    {
+    case TOKassign: case TOKconstruct: case TOKblit:
+    case TOKaddass: case TOKminass: case TOKmulass: case TOKdivass:
+    case TOKmodass: case TOKpowass: case TOKandass: case TOKorass:
+    case TOKxorass: case TOKshlass: case TOKshrass: case TOKushrass:
+    case TOKcatass:
+    case TOKplusplus: case TOKminusminus:
+      bounds_lvalue (((BinExp *) e)->e1, &bs->assigned);
+      break;
+
+    case TOKpreplusplus: case TOKpreminusminus:
+      bounds_lvalue (((PreExp *) e)->e1, &bs->assigned);
+      break;
+
+    case TOKaddress:
+    case TOKdelegate:
+      bounds_lvalue (((UnaExp *) e)->e1, &bs->escaped);
+      break;
+
+    case TOKsymoff:
+      bounds_lvalue (e, &bs->escaped);
+      break;
+
+    case TOKcall:
+      {
+	CallExp *ce = (CallExp *) e;
+	TypeFunction *tf = IRState::getFuncType (ce->e1->type->toBasetype());
+	Expressions *args = ce->arguments;
+
+	// The object of a struct member function is passed by reference.
+	if (ce->e1->op == TOKdotvar
+	    && ((DotVarExp *) ce->e1)->e1->type->toBasetype()->ty == Tstruct)
+	  bounds_lvalue (((DotVarExp *) ce->e1)->e1, &bs->escaped);
+
+	for (size_t i = 0; args && i < args->dim; i++)
+	  {
+	    Parameter *arg = tf ? Parameter::getNth (tf->parameters, i) : NULL;
+	    if (!tf || (arg && (arg->storageClass & (STCref | STCout | STClazy))))
+	      bounds_lvalue ((*args)[i], &bs->escaped);
+	  }
+	break;
+      }
+
+    case TOKnew:
+      {
+	NewExp *ne = (NewExp *) e;
+	for (size_t i = 0; ne->arguments && i < ne->arguments->dim; i++)
+	  bounds_lvalue ((*ne->arguments)[i], &bs->escaped);
+	break;
+      }
+
+    case TOKdeclaration:
+      {
+	// The initializer is not part of the tree apply walks.
+	VarDeclaration *v = ((DeclarationExp *) e)->declaration->isVarDeclaration();
+	Expression *init = v ? bounds_init (v) : NULL;
+	if (init)
+	  {
+	    if (v->storage_class & (STCref | STCout))
+	      bounds_lvalue (init, &bs->escaped);
+	    bs->scan (init);
+	  }
+	break;
+      }
+
+    default:
+      break;
+    }
+  return 0;
+}
+
+void
+BoundsScan::scan (Expression *e)
+{
+  if (e)
+    e->apply (&bounds_scan_exp, this);
+}
+
+unsigned
+BoundsScan::assignCount (VarDeclaration *v)
+{
+  unsigned n = 0;
+  for (size_t i = 0; i < this->assigned.dim; i++)
+    {
+      if (this->assigned[i] == v)
+	n++;
+    }
+  return n;
+}
+
+bool
+BoundsScan::isEscaped (VarDeclaration *v)
+{
+  for (size_t i = 0; i < this->escaped.dim; i++)
+    {
+      if (this->escaped[i] == v)
+	return true;
+    }
+  return false;
+}
+
+/* Statements that are not handled here could do anything.  */
+
+void
+Statement::boundsScan (BoundsScan *bs)
+{
+  bs->unknown = true;
+}
+
+void
+ExpStatement::boundsScan (BoundsScan *bs)
+{
+  bs->scan (exp);
+}
+
+void
+CompoundStatement::boundsScan (BoundsScan *bs)
+{
+  for (size_t i = 0; i < statements->dim; i++)
+    {
+      Statement *s = (*statements)[i];
+      if (s)
+	s->boundsScan (bs);
+    }
+}
+
+void
+UnrolledLoopStatement::boundsScan (BoundsScan *bs)
+{
+  for (size_t i = 0; i < statements->dim; i++)
+    {
+      Statement *s = (*statements)[i];
+      if (s)
+	s->boundsScan (bs);
+    }
+}
+
+void
+ScopeStatement::boundsScan (BoundsScan *bs)
+{
+  if (statement)
+    statement->boundsScan (bs);
+}
+
+void
+WhileStatement::boundsScan (BoundsScan *bs)
+{
+  bs->scan (condition);
+  if (body)
+    body->boundsScan (bs);
+}
+
+void
+DoStatement::boundsScan (BoundsScan *bs)
+{
+  if (body)
+    body->boundsScan (bs);
+  bs->scan (condition);
+}
+
+void
+ForStatement::boundsScan (BoundsScan *bs)
+{
+  if (init)
+    init->boundsScan (bs);
+  bs->scan (condition);
+  bs->scan (increment);
+  if (body)
+    body->boundsScan (bs);
+}
+
+void
+IfStatement::boundsScan (BoundsScan *bs)
+{
+  bs->scan (condition);
+  if (ifbody)
+    ifbody->boundsScan (bs);
+  if (elsebody)
+    elsebody->boundsScan (bs);
+}
+
+void
+PragmaStatement::boundsScan (BoundsScan *bs)
+{
+  if (body)
+    body->boundsScan (bs);
+}
+
+void
+SwitchStatement::boundsScan (BoundsScan *bs)
+{
+  bs->scan (condition);
+  bs->inSwitch++;
+  if (body)
+    body->boundsScan (bs);
+  bs->inSwitch--;
+}
+
+void
+CaseStatement::boundsScan (BoundsScan *bs)
+{
+  if (!bs->inSwitch)
+    bs->entered = true;
+  if (statement)
+    statement->boundsScan (bs);
+}
+
+void
+DefaultStatement::boundsScan (BoundsScan *bs)
+{
+  if (!bs->inSwitch)
+    bs->entered = true;
+  if (statement)
+    statement->boundsScan (bs);
+}
+
+void
+GotoDefaultStatement::boundsScan (BoundsScan *)
+{
+}
+
+void
+GotoCaseStatement::boundsScan (BoundsScan *)
+{
+}
+
+void
+SwitchErrorStatement::boundsScan (BoundsScan *)
+{
+}
+
+void
+ReturnStatement::boundsScan (BoundsScan *bs)
+{
+  bs->scan (exp);
+}
+
+void
+BreakStatement::boundsScan (BoundsScan *)
+{
+}
+
+void
+ContinueStatement::boundsScan (BoundsScan *)
+{
+}
+
+void
+SynchronizedStatement::boundsScan (BoundsScan *bs)
+{
+  bs->scan (exp);
+  if (body)
+    body->boundsScan (bs);
+}
+
+void
+WithStatement::boundsScan (BoundsScan *bs)
+{
+  // The with object is referred to in the body through wthis.
+  bs->scan (exp);
+  if (exp)
+    bounds_lvalue (exp, &bs->escaped);
+  if (body)
+    body->boundsScan (bs);
+}
+
+void
+TryCatchStatement::boundsScan (BoundsScan *bs)
+{
+  if (body)
+    body->boundsScan (bs);
+  for (size_t i = 0; i < catches->dim; i++)
+    {
+      Catch *c = (*catches)[i];
+      if (c->handler)
+	c->handler->boundsScan (bs);
+    }
+}
+
+void
+TryFinallyStatement::boundsScan (BoundsScan *bs)
+{
+  if (body)
+    body->boundsScan (bs);
+  if (finalbody)
+    finalbody->boundsScan (bs);
+}
+
+void
+OnScopeStatement::boundsScan (BoundsScan *bs)
+{
+  if (statement)
+    statement->boundsScan (bs);
+}
+
+void
+ThrowStatement::boundsScan (BoundsScan *bs)
+{
+  bs->scan (exp);
+}
+
+void
+VolatileStatement::boundsScan (BoundsScan *bs)
+{
+  if (statement)
+    statement->boundsScan (bs);
+}
+
+void
+GotoStatement::boundsScan (BoundsScan *)
+{
+}
+
+void
+LabelStatement::boundsScan (BoundsScan *bs)
+{
+  bs->entered = true;
+  if (statement)
+    statement->boundsScan (bs);
+}
+
+void
+ImportStatement::boundsScan (BoundsScan *)
+{
+}
+
+/* Return NULL if V is a variable of the function being compiled that can
+   only be changed by assignments to it, otherwise the reason why not.  */
+
+static const char *
+bounds_local_p (IRState *irs, VarDeclaration *v)
+{
+  if (v->toParent2() != irs->func || v->isDataseg()
+      || (v->storage_class & (STCref | STCout | STClazy | STCfield)))
+    return concat ("'", v->toChars(), "' is not a local variable", NULL);
+
+  if (v->nestedrefs.dim)
+    return concat ("'", v->toChars(), "' is used by a nested function", NULL);
+
+  if (!irs->funcScan)
+    {
+      irs->funcScan = new BoundsScan();
+      if (irs->func->fbody)
+	irs->func->fbody->boundsScan (irs->funcScan);
+    }
+
+  if (irs->funcScan->unknown)
+    return "the function could not be analyzed";
+
+  if (irs->funcScan->isEscaped (v))
+    return concat ("'", v->toChars(), "' may be changed through a reference", NULL);
+
+  return NULL;
+}
+
+/* If STMT tests that its variable is below the length of an array or
+   a constant, record that for the loop body and return true.  */
+
+bool
+IRState::pushBoundsFact (ForStatement *stmt)
+{
+  if (!arrayBoundsCheck() || !stmt->condition || !stmt->body)
+    return false;
+
+  // i < bound, or bound > i.
+  Expression *cond = stmt->condition;
+  Expression *e_index, *e_bound;
+
+  if (cond->op == TOKlt)
+    {
+      e_index = ((CmpExp *) cond)->e1;
+      e_bound = ((CmpExp *) cond)->e2;
+    }
+  else if (cond->op == TOKgt)
+    {
+      e_index = ((CmpExp *) cond)->e2;
+      e_bound = ((CmpExp *) cond)->e1;
+    }
+  else
+    return false;
+
+  // Narrowing the index could make it pass the test when it shouldn't.
+  e_index = bounds_strip (e_index, false);
+  if (e_index->op != TOKvar || !e_index->type->isintegral())
+    return false;
+
+  BoundsFact fact;
+  fact.index = ((VarExp *) e_index)->var->isVarDeclaration();
+  fact.array = NULL;
+  fact.limit = 0;
+  fact.reason = NULL;
+
+  if (!fact.index)
+    return false;
+
+  /* The bound is the length of an array or a constant, either directly
+     or through a variable initialized with it, as in the lowering of
+     foreach (i; 0 .. a.length).  */
+  VarDeclaration *v_limit = bounds_var (e_bound);
+  if (v_limit && v_limit->type->isintegral() && bounds_init (v_limit))
+    e_bound = bounds_init (v_limit);
+  else
+    v_limit = NULL;
+
+  e_bound = bounds_strip (e_bound, true);
+
+  if (e_bound->op == TOKarraylength)
+    {
+      fact.array = bounds_var (((ArrayLengthExp *) e_bound)->e1);
+      if (!fact.array)
+	return false;
+    }
+  else if (e_bound->op == TOKint64)
+    {
+      fact.limit = e_bound->toInteger();
+      if (!e_bound->type->isunsigned() && (sinteger_t) fact.limit < 0)
+	return false;
+    }
+  else
+    return false;
+
+  // Check that the fact holds throughout the body.
+  BoundsScan body;
+  stmt->body->boundsScan (&body);
+
+  const char *reason = NULL;
+  if (body.unknown)
+    reason = "the loop body could not be analyzed";
+  else if (body.entered)
+    reason = "the loop body has labels";
+  else if ((reason = bounds_local_p (this, fact.index)) != NULL)
+    ;
+  else if (body.assignCount (fact.index))
+    reason = concat ("'", fact.index->toChars(), "' is assigned in the loop", NULL);
+  else if (fact.array && (reason = bounds_local_p (this, fact.array)) != NULL)
+    ;
+  else if (fact.array && body.assignCount (fact.array))
+    reason = concat ("'", fact.array->toChars(), "' is assigned in the loop", NULL);
+  else if (v_limit && (reason = bounds_local_p (this, v_limit)) != NULL)
+    ;
+  else if (v_limit && funcScan->assignCount (v_limit))
+    reason = concat ("'", v_limit->toChars(), "' is assigned to", NULL);
+  else if (v_limit && fact.array && funcScan->assignCount (fact.array)
+	   && strncmp (v_limit->ident->toChars(), "__limit", 7) != 0)
+    {
+      // The array could have changed since the bound was read, unless
+      // the bound is the one of a foreach, read just before the loop.
+      reason = concat ("'", fact.array->toChars(), "' is assigned to", NULL);
+    }
+  else if (!fact.index->type->isunsigned())
+    {
+      /* A signed index is not negative if it starts out that way and the
+	 loop increment is the only other assignment to it.  Then it only
+	 ever goes up from there while below the bound.  */
+      Expression *e_init = bounds_init (fact.index);
+      Expression *inc = stmt->increment;
+      bool up_p = false;
+
+      if (inc && inc->op == TOKpreplusplus)
+	up_p = bounds_var (((PreExp *) inc)->e1) == fact.index;
+      else if (inc && (inc->op == TOKplusplus || inc->op == TOKaddass))
+	up_p = bounds_var (((BinExp *) inc)->e1) == fact.index
+	  && ((BinExp *) inc)->e2->isConst()
+	  && (sinteger_t) ((BinExp *) inc)->e2->toInteger() > 0;
+
+      if (!e_init || e_init->getIntRange().imin.negative)
+	reason = concat ("'", fact.index->toChars(), "' may be negative", NULL);
+      else if (!up_p || funcScan->assignCount (fact.index) != 1)
+	reason = concat ("'", fact.index->toChars(),
+			 "' may be negative, it is assigned outside the loop increment",
+			 NULL);
+    }
+
+  fact.reason = reason;
+  this->boundsFacts.push (new BoundsFact (fact));
+  return true;
+}
+
+void
+IRState::popBoundsFact (void)
+{
+  this->boundsFacts.pop();
+}
+
+/* Return true if INDEX < ARRAY.length, or INDEX <= ARRAY.length if
+   INCLUSIVE, is known.  Otherwise set REASON to why not.  */
+
+static bool
+bounds_below (IRState *irs, Expression *index, Expression *array,
+	      VarDeclaration *length_var, bool inclusive, const char **reason)
+{
+  Type *tb = array->type->toBasetype();
+  VarDeclaration *v_array = bounds_var (array);
+  VarDeclaration *v_index = bounds_var (index);
+
+  // a.length, or $ in a[...], which is LENGTH_VAR.
+  if (inclusive)
+    {
+      Expression *e = bounds_strip (index, true);
+      if (e->op == TOKarraylength && v_array
+	  && bounds_var (((ArrayLengthExp *) e)->e1) == v_array)
+	{
+	  *reason = "the bound is the length of the array";
+	  return true;
+	}
+      if (v_index && v_index == length_var)
+	{
+	  *reason = "the bound is the length of the array";
+	  return true;
+	}
+    }
+
+  dinteger_t dim = 0;
+  if (tb->ty == Tsarray)
+    {
+      dim = ((TypeSArray *) tb)->dim->toInteger();
+      IntRange ir = index->getIntRange();
+      SignExtendedNumber limit (inclusive ? dim + 1 : dim);
+
+      if (!ir.imin.negative && ir.imax < limit)
+	{
+	  *reason = "the index is in range of the static array";
+	  return true;
+	}
+    }
+
+  if (!v_index)
+    {
+      *reason = tb->ty == Tsarray
+	? "the index may be out of range of the static array"
+	: "the index is not a loop variable";
+      return false;
+    }
+
+  const char *first = NULL;
+  for (size_t i = irs->boundsFacts.dim; i-- > 0; )
+    {
+      BoundsFact *fact = irs->boundsFacts[i];
+      if (fact->index != v_index)
+	continue;
+
+      if (fact->reason)
+	{
+	  if (!first)
+	    first = fact->reason;
+	  continue;
+	}
+      if (fact->array && fact->array == v_array)
+	{
+	  *reason = concat ("'", v_index->toChars(), "' is below '",
+			    v_array->toChars(), ".length' in the loop", NULL);
+	  return true;
+	}
+      if (!fact->array && tb->ty == Tsarray && fact->limit <= dim)
+	{
+	  *reason = concat ("'", v_index->toChars(),
+			    "' is below the static array length in the loop", NULL);
+	  return true;
+	}
+      if (!first)
+	first = concat ("the loop bounds '", v_index->toChars(),
+			"' by something other than this array", NULL);
+    }
+
+  *reason = first ? first : concat ("'", v_index->toChars(),
+				    "' is not bounded by a loop over the array", NULL);
+  return false;
+}
+
+/* Return true if the bounds check of E can be left out.  */
+
+bool
+IRState::indexInBounds (IndexExp *e)
+{
+  const char *reason;
+  bool removed;
+
+  if (e->skipboundscheck)
+    {
+      removed = true;
+      reason = "the index of a foreach over the array";
+    }
+  else
+    removed = bounds_below (this, e->e2, e->e1, e->lengthVar, false, &reason);
+
+  bounds_report (e->loc, e, !removed, reason);
+  return removed;
+}
+
+/* Set UPR_OK if the upper bound of E is known to be within the array,
+   and LWR_OK if the lower bound is known to be no greater than it.  */
+
+void
+IRState::sliceInBounds (SliceExp *e, bool *upr_ok, bool *lwr_ok)
+{
+  const char *reason = "there is no upper bound";
+
+  *upr_ok = *lwr_ok = false;
+  if (!e->upr)
+    return;
+
+  Type *tb = e->e1->type->toBasetype();
+  if (tb->ty == Tarray || tb->ty == Tsarray)
+    *upr_ok = bounds_below (this, e->upr, e->e1, e->lengthVar, true, &reason);
+  else
+    reason = "a pointer has no length to check against";
+
+  if (!e->lwr || (e->lwr->isConst() && e->lwr->toInteger() == 0))
+    *lwr_ok = true;
+  else
+    {
+      IntRange lwr_range = e->lwr->getIntRange();
+      IntRange upr_range = e->upr->getIntRange();
+      const char *lwr_reason;
+
+      if (!lwr_range.imin.negative && lwr_range.imax <= upr_range.imin)
+	*lwr_ok = true;
+      else if (e->lengthVar && bounds_var (e->upr) == e->lengthVar
+	       && bounds_below (this, e->lwr, e->e1, NULL, false, &lwr_reason))
+	*lwr_ok = true;	// a[i .. $]
+      else if (*upr_ok)
+	reason = "the lower bound may be above the upper bound";
+    }
+
+  if (*upr_ok && *lwr_ok)
+    reason = "the bounds are within the array";
+  bounds_report (e->loc, e, !(*upr_ok && *lwr_ok), reason);
+}
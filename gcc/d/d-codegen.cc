@@ -264,6 +264,111 @@ IRState::var (VarDeclaration *v)
 }
 
 
+/* Casts between classes that are not interfaces are done in place when
+   the target class is final, by comparing the vtbl of the object with the
+   one of the class.  Otherwise, when optimizing, the first few ClassInfo
+   of the object and its bases are compared with the target class, up to
+   the class of the static type.  Deeper hierarchies and interfaces are left
+   to _d_dynamic_cast and _d_interface_cast.  */
+
+// Number of base classes looked at before calling _d_dynamic_cast.
+#define DYNAMIC_CAST_DEPTH 3
+
+/* Return the offset of the base field in ClassInfo, see the layout in
+   ClassDeclaration::toObjFile, or 0 if there is no ClassInfo.  */
+
+static unsigned
+classinfo_base_offset (void)
+{
+  ClassDeclaration *cd = ClassDeclaration::classinfo;
+  if (!cd)
+    return 0;
+
+  for (size_t i = 0; i < cd->fields.dim; i++)
+    {
+      VarDeclaration *v = cd->fields[i];
+      if (!strcmp (v->ident->string, "base"))
+	return v->offset;
+    }
+
+  // The inline casts depend on the layout in object.d.
+  gcc_unreachable ();
+}
+
+/* Return EXP, an object of class OBJ_CLASS_DECL, cast to the class or
+   interface TARGET_CLASS_DECL, or null if it is not one.  */
+
+tree
+IRState::dynamicCast (tree exp, ClassDeclaration *obj_class_decl,
+		      ClassDeclaration *target_class_decl)
+{
+  tree t_target = target_class_decl->type->toCtype();
+  tree t_classinfo = addressOf (target_class_decl->toSymbol()->Stree);
+  bool inline_p = !obj_class_decl->isInterfaceDeclaration()
+    && !target_class_decl->isInterfaceDeclaration()
+    && !obj_class_decl->isCOMclass() && !target_class_decl->isCOMclass();
+  bool final_p = (target_class_decl->storage_class & STCfinal) != 0;
+  unsigned base_offset = classinfo_base_offset();
+
+  if (!inline_p || (!final_p && (!optimize || optimize_size || !base_offset)))
+    {
+      tree args[2] = {
+	  exp,
+	  t_classinfo
+      }; // %% (and why not just addressOf (target_class_decl)
+      return libCall (obj_class_decl->isInterfaceDeclaration()
+		      ? LIBCALL_INTERFACE_CAST : LIBCALL_DYNAMIC_CAST, 2, args);
+    }
+
+  exp = maybeMakeTemp (exp);
+  tree t_obj = nop (exp, t_target);
+  tree t_null = nop (d_null_pointer, t_target);
+  tree t_vptr = indirect (exp);
+  t_vptr = component (t_vptr, TYPE_FIELDS (TREE_TYPE (t_vptr)));
+  tree result;
+
+  if (final_p)
+    {
+      // The class can't be derived from, the object must be one exactly.
+      tree t_vtbl = addressOf (target_class_decl->toVtblSymbol()->Stree);
+      result = build3 (COND_EXPR, t_target,
+		       boolOp (EQ_EXPR, convert (ptr_type_node, t_vptr),
+			       convert (ptr_type_node, t_vtbl)),
+		       t_obj, t_null);
+    }
+  else
+    {
+      tree args[2] = { exp, t_classinfo };
+      tree t_static = addressOf (obj_class_decl->toSymbol()->Stree);
+      tree t_ci[DYNAMIC_CAST_DEPTH];
+
+      // The first entry of the vtbl is the ClassInfo.
+      t_ci[0] = save_expr (indirect (t_vptr, ptr_type_node));
+      for (int i = 1; i < DYNAMIC_CAST_DEPTH; i++)
+	t_ci[i] = save_expr (indirect (pointerOffset (t_ci[i - 1],
+						       size_int (base_offset)),
+					ptr_type_node));
+
+      // Once the static class is reached, the target can't be further up.
+      result = nop (libCall (LIBCALL_DYNAMIC_CAST, 2, args), t_target);
+      for (int i = DYNAMIC_CAST_DEPTH - 1; i >= 0; i--)
+	{
+	  result = build3 (COND_EXPR, t_target,
+			   boolOp (EQ_EXPR, t_ci[i],
+				   convert (ptr_type_node, t_static)),
+			   t_null, result);
+	  result = build3 (COND_EXPR, t_target,
+			   boolOp (EQ_EXPR, t_ci[i],
+				   convert (ptr_type_node, t_classinfo)),
+			   t_obj, result);
+	}
+    }
+
+  return build3 (COND_EXPR, t_target,
+		 boolOp (NE_EXPR, exp, d_null_pointer),
+		 result, t_null);
+}
+
 tree
 IRState::convertTo (Expression *exp, Type *target_type)
 {
@@ -364,12 +469,7 @@ IRState::convertTo (tree exp, Type *exp_type, Type *target_type)
 	if (use_dynamic)
 	  {
 	    // Otherwise, do dynamic cast
-	    tree args[2] = {
-		exp,
-		addressOf (target_class_decl->toSymbol()->Stree)
-	    }; // %% (and why not just addressOf (target_class_decl)
-	    return libCall (obj_class_decl->isInterfaceDeclaration()
-			    ? LIBCALL_INTERFACE_CAST : LIBCALL_DYNAMIC_CAST, 2, args);
+	    return dynamicCast (exp, obj_class_decl, target_class_decl);
 	  }
 	else
 	  {
@@ -1868,10 +1968,9 @@ IRState::arrayElemRef (IndexExp *aer_exp, ArrayScope *aryscp)
 	  tree e1_tree = e1->toElem (this);
 	  e1_tree = aryscp->setArrayExp (e1_tree, e1->type);
 
-	  // If it's a static array and the index is constant,
-	  // the front end has already checked the bounds.
-	  if (arrayBoundsCheck() &&
-	      !(base_type_ty == Tsarray && e2->isConst()))
+	  // Leave out the check if the index is known to be in bounds,
+	  // see d-bounds.cc.
+	  if (arrayBoundsCheck() && !indexInBounds (aer_exp))
 	    {
 	      tree array_len_expr, throw_expr, oob_cond;
 	      // implement bounds check as a conditional expression:
@@ -2247,8 +2346,8 @@ IRState::assertCall (Loc loc, Expression *msg)
 static const char *libcall_ids[LIBCALL_count] = {
     "_d_assert", "_d_assert_msg", "_d_array_bounds", "_d_switch_error",
     /*"_d_invariant",*/ "_D9invariant12_d_invariantFC6ObjectZv",
-    "_d_newclass", "_d_newarrayT",
-    "_d_newarrayiT",
+    "_d_newclass", "_d_newclassN", "_d_newarrayT",
+    "_d_newarrayiT", "_d_newarrayN",
     "_d_newarraymTp", "_d_newarraymiTp",
     "_d_allocmemory",
     "_d_delclass", "_d_delinterface", "_d_delarray",
@@ -2321,6 +2420,12 @@ IRState::getLibCallDecl (LibCall lib_call)
 	  return_type = getObjectType();
 	  break;
 
+	case LIBCALL_NEWCLASSN:
+	  arg_types.push (Type::tsize_t);
+	  arg_types.push (Type::tbool);
+	  return_type = Type::tvoidptr;
+	  break;
+
 	case LIBCALL_NEWARRAYT:
 	case LIBCALL_NEWARRAYIT:
 	  arg_types.push (Type::typeinfo->type);
@@ -2328,6 +2433,15 @@ IRState::getLibCallDecl (LibCall lib_call)
 	  return_type = Type::tvoid->arrayOf();
 	  break;
 
+	case LIBCALL_NEWARRAYN:
+	  arg_types.push (Type::tsize_t);
+	  arg_types.push (Type::tsize_t);
+	  arg_types.push (Type::tbool);
+	  arg_types.push (Type::tbool);
+	  arg_types.push (Type::tbool);
+	  return_type = Type::tvoid->arrayOf();
+	  break;
+
 	case LIBCALL_NEWARRAYMTP:
 	case LIBCALL_NEWARRAYMITP:
 	  arg_types.push (Type::typeinfo->type);
@@ -3728,7 +3842,7 @@ IRState::getFrameInfo (FuncDeclaration *fd)
     ffi->creates_frame = true;
 
   // D2 maybe setup closure instead.
-  if (fd->needsClosure())
+  if (needsClosure (fd))
     {
       ffi->creates_frame = true;
       ffi->is_closure = true;
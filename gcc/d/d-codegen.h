@@ -29,8 +29,10 @@ enum LibCall
   LIBCALL_SWITCH_ERROR,
   LIBCALL_INVARIANT,
   LIBCALL_NEWCLASS,
+  LIBCALL_NEWCLASSN,
   LIBCALL_NEWARRAYT,
   LIBCALL_NEWARRAYIT,
+  LIBCALL_NEWARRAYN,
   LIBCALL_NEWARRAYMTP,
   LIBCALL_NEWARRAYMITP,
   LIBCALL_ALLOCMEMORY,
@@ -103,6 +105,39 @@ struct FuncFrameInfo
   };
 };
 
+// Variables that may change between the test of a loop and a use in its
+// body, as found by Statement::boundsScan.  See d-bounds.cc.
+// Also walks functions for the escape analysis in d-escape.cc.
+struct BoundsScan
+{
+  VarDeclarations assigned;   // once for each assignment
+  VarDeclarations escaped;    // address taken or passed by reference
+  bool unknown;               // something that could not be scanned
+  bool entered;               // has labels that may be jumped to from outside
+  unsigned inSwitch;
+
+  BoundsScan (void)
+    : unknown(false), entered(false), inSwitch(0)
+  { }
+
+  virtual void scan (Expression *e);
+  unsigned assignCount (VarDeclaration *v);
+  bool isEscaped (VarDeclaration *v);
+};
+
+// In the body of the loop being compiled INDEX < ARRAY.length, or
+// INDEX < LIMIT if ARRAY is NULL.  If REASON is set, the loop has the
+// shape of such a loop but the bound could not be proven.
+struct BoundsFact
+{
+  VarDeclaration *index;
+  VarDeclaration *array;
+  dinteger_t limit;
+  const char *reason;
+};
+
+typedef ArrayBase<BoundsFact> BoundsFacts;
+
 class ArrayScope;
 
 // Code generation routines should be in a separate namespace, but so many
@@ -158,6 +193,8 @@ struct IRState : IRBase
   // 'convertTo' just to give it a different name from the extern "C" convert
   tree convertTo (Expression *exp, Type *target_type);
   tree convertTo (tree exp, Type *exp_type, Type *target_type);
+  tree dynamicCast (tree exp, ClassDeclaration *obj_class_decl,
+		    ClassDeclaration *target_class_decl);
 
   tree convertForAssignment (Expression *exp, Type *target_type);
   tree convertForAssignment (tree exp_tree, Type *exp_type, Type *target_type);
@@ -270,6 +307,15 @@ struct IRState : IRBase
   tree boundsCond (tree index, tree upper_bound, bool inclusive);
   int arrayBoundsCheck (void);
 
+  // Bounds check elimination, see d-bounds.cc.
+  BoundsScan *funcScan;
+  BoundsFacts boundsFacts;
+
+  bool pushBoundsFact (ForStatement *stmt);
+  void popBoundsFact (void);
+  bool indexInBounds (IndexExp *e);
+  void sliceInBounds (SliceExp *e, bool *upr_ok, bool *lwr_ok);
+
   tree arrayElemRef (IndexExp *aer_exp, ArrayScope *aryscp);
 
   static tree binding (tree var_chain, tree body);
@@ -308,6 +354,9 @@ struct IRState : IRBase
   TemplateEmission emitTemplates;
   bool splitDynArrayVarArgs;
   bool useBuiltins;
+  bool inlineAA;
+  bool inlineImports;
+  bool reportBoundsChecks;
   bool stdInc;
 
   // Variables that are in scope that will need destruction later
@@ -384,6 +433,7 @@ struct IRState : IRBase
 
   void buildChain (FuncDeclaration *func);
   static FuncFrameInfo *getFrameInfo (FuncDeclaration *fd);
+  static bool needsClosure (FuncDeclaration *fd);
   static bool functionNeedsChain (FuncDeclaration *f);
 
   // Check for nested functions/class/structs
@@ -600,6 +600,9 @@ FuncDeclaration::toSymbol (void)
 	  if (! ident)
 	    TREE_PUBLIC (fndecl) = 0;
 
+	  if (gen.inlineImports && DECL_EXTERNAL (fndecl) && fbody)
+	    g.ofile->importedFuncs.push (this);
+
 	  TREE_USED (fndecl) = 1; // %% Probably should be a little more intelligent about this
 
 	  // %% hack: on darwin (at least) using a DECL_EXTERNAL (IRState::getLibCallDecl)
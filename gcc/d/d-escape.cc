@@ -0,0 +1,401 @@
+// d-escape.cc -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+// Escape analysis of the delegates to nested functions, which decides
+// whether the frame of a function is a closure allocated on the heap.
+//
+// FuncDeclaration::needsClosure assumes that a nested function escapes as
+// soon as a delegate to it is made, unless it is given straight to a scope
+// parameter.  Here the function and all the functions nested in it are
+// looked at, and a delegate is known not to escape if it is
+//  - called right away;
+//  - passed to a scope or lazy parameter, or to opApply as foreach does;
+//  - stored in a local variable that is only used in those ways.
+// Anything that could not be scanned, such as inline assembler or a nested
+// class, leaves the frame on the heap.
+
+#include "d-gcc-includes.h"
+#include "d-lang.h"
+#include "d-codegen.h"
+
+#include "init.h"
+#include "template.h"
+#include "id.h"
+
+struct EscapeScan : BoundsScan
+{
+  FuncDeclaration *outer;
+  Expressions sites;		// delegates made, and
+  FuncDeclarations siteFuncs;	// the function of each
+  FuncDeclarations leaked;	// delegates made in functions that may escape
+  Expressions safe;		// expressions used in a way that doesn't escape
+  VarDeclarations locals;	// local delegate variables, and
+  Expressions localInits;	// the delegate each is initialized with
+  Expressions uses;		// all reads of delegate variables
+  unsigned inEscaping;
+
+  EscapeScan (FuncDeclaration *fd)
+    : outer(fd), inEscaping(0)
+  { }
+
+  void scan (Expression *e);
+  void scanFunction (FuncDeclaration *f);
+  bool isSafe (Expression *e);
+  bool escapes (FuncDeclaration *f, Loc *loc);
+};
+
+static bool
+escape_member_p (Expressions *a, Expression *e)
+{
+  for (size_t i = 0; i < a->dim; i++)
+    {
+      if ((*a)[i] == e)
+	return true;
+    }
+  return false;
+}
+
+/* Return E without the casts around it.  */
+
+static Expression *
+escape_strip (Expression *e)
+{
+  while (e->op == TOKcast)
+    e = ((CastExp *) e)->e1;
+  return e;
+}
+
+/* Return true if S is part of a template instantiated with symbols local
+   to OUTER, which can make delegates that are not seen by the scan.  */
+
+static bool
+escape_local_instance_p (Dsymbol *s, FuncDeclaration *outer)
+{
+  for (; s; s = s->parent)
+    {
+      TemplateInstance *ti = s->isTemplateInstance();
+      if (!ti || !ti->isnested)
+	continue;
+
+      for (Dsymbol *p = ti->isnested; p; p = p->parent)
+	{
+	  if (p == outer)
+	    return true;
+	}
+    }
+  return false;
+}
+
+/* Return true if E is the body of a foreach statement, lowered to a
+   delegate literal to pass to opApply.  */
+
+static bool
+escape_foreach_body_p (Expression *e)
+{
+  FuncDeclaration *fd = NULL;
+  if (e->op == TOKfunction)
+    fd = ((FuncExp *) e)->fd;
+  else if (e->op == TOKdelegate)
+    fd = ((DelegateExp *) e)->func;
+
+  return fd && fd->isFuncLiteralDeclaration() && fd->fes;
+}
+
+/* Called by Expression::apply on each node E of the expression
+   given to EscapeScan::scan.  Children are seen before their parent,
+   so what is safe is only decided once the whole function is scanned.  */
+
+static int
+escape_scan_exp (Expression *e, void *param)
+{
+  EscapeScan *es = (EscapeScan *) param;
+  Dsymbol *sym = NULL;
+
+  switch (e->op)
+    {
+    case TOKdelegate:
+      sym = ((DelegateExp *) e)->func;
+      es->sites.push (e);
+      es->siteFuncs.push ((FuncDeclaration *) sym);
+      if (es->inEscaping)
+	es->leaked.push ((FuncDeclaration *) sym);
+      break;
+
+    case TOKfunction:
+      {
+	FuncExp *fe = (FuncExp *) e;
+	es->sites.push (e);
+	es->siteFuncs.push (fe->fd);
+	if (es->inEscaping)
+	  es->leaked.push (fe->fd);
+	es->scanFunction (fe->fd);
+	break;
+      }
+
+    case TOKvar:
+      {
+	VarDeclaration *v = ((VarExp *) e)->var->isVarDeclaration();
+	if (v && v->type->toBasetype()->ty == Tdelegate)
+	  es->uses.push (e);
+	sym = ((VarExp *) e)->var;
+	break;
+      }
+
+    case TOKdotvar:
+      sym = ((DotVarExp *) e)->var;
+      break;
+
+    case TOKsymoff:
+      sym = ((SymOffExp *) e)->var;
+      break;
+
+    case TOKcall:
+      {
+	CallExp *ce = (CallExp *) e;
+	TypeFunction *tf = IRState::getFuncType (ce->e1->type->toBasetype());
+	Expressions *args = ce->arguments;
+	Expression *callee = escape_strip (ce->e1);
+	FuncDeclaration *fd = NULL;
+
+	es->safe.push (callee);
+	if (callee->op == TOKvar)
+	  fd = ((VarExp *) callee)->var->isFuncDeclaration();
+	else if (callee->op == TOKdotvar)
+	  fd = ((DotVarExp *) callee)->var->isFuncDeclaration();
+
+	// The body of a foreach given to opApply is assumed to only be
+	// called while it runs, as the frontend does.  Any other delegate,
+	// even one passed to opApply explicitly, may be kept by the callee.
+	bool apply_p = fd && (fd->ident == Id::apply
+			      || fd->ident == Id::applyReverse);
+
+	for (size_t i = 0; args && i < args->dim; i++)
+	  {
+	    Parameter *arg = tf ? Parameter::getNth (tf->parameters, i) : NULL;
+	    Expression *earg = escape_strip ((*args)[i]);
+	    if ((apply_p && escape_foreach_body_p (earg))
+		|| (arg && !tf->parameterEscapes (arg)))
+	      es->safe.push (earg);
+	  }
+	break;
+      }
+
+    case TOKdeclaration:
+      {
+	Dsymbol *s = ((DeclarationExp *) e)->declaration;
+	VarDeclaration *v = s->isVarDeclaration();
+	FuncDeclaration *f = s->isFuncDeclaration();
+	if (v)
+	  {
+	    // The initializer is not part of the tree apply walks.
+	    ExpInitializer *ie = v->init ? v->init->isExpInitializer() : NULL;
+	    if (!ie)
+	      break;
+
+	    Expression *init = ie->exp;
+	    if ((init->op == TOKconstruct || init->op == TOKblit)
+		&& ((AssignExp *) init)->e1->op == TOKvar
+		&& ((VarExp *) ((AssignExp *) init)->e1)->var == v)
+	      {
+		es->safe.push (((AssignExp *) init)->e1);
+		es->locals.push (v);
+		es->localInits.push (escape_strip (((AssignExp *) init)->e2));
+	      }
+	    es->scan (init);
+	  }
+	else if (f)
+	  es->scanFunction (f);
+	else if (!s->isAliasDeclaration() && !s->isTypedefDeclaration())
+	  es->unknown = true;
+	break;
+      }
+
+    default:
+      break;
+    }
+
+  if (sym && escape_local_instance_p (sym, es->outer))
+    es->unknown = true;
+
+  return 0;
+}
+
+void
+EscapeScan::scan (Expression *e)
+{
+  if (e)
+    e->apply (&escape_scan_exp, this);
+}
+
+/* Scan the body and contracts of F.  Delegates made in a nested function
+   that may itself escape are assumed to escape with it.  */
+
+void
+EscapeScan::scanFunction (FuncDeclaration *f)
+{
+  bool escaping_p = f != this->outer && (f->isThis() || f->tookAddressOf);
+  if (escaping_p)
+    this->inEscaping++;
+
+  if (f->frequire)
+    f->frequire->boundsScan (this);
+  if (f->fbody)
+    f->fbody->boundsScan (this);
+  if (f->fensure)
+    f->fensure->boundsScan (this);
+
+  if (escaping_p)
+    this->inEscaping--;
+}
+
+/* Return true if the delegate E is only used in ways that don't let it
+   outlive the function making it.  */
+
+bool
+EscapeScan::isSafe (Expression *e)
+{
+  if (escape_member_p (&this->safe, e))
+    return true;
+
+  for (size_t i = 0; i < this->locals.dim; i++)
+    {
+      if (this->localInits[i] != e)
+	continue;
+
+      VarDeclaration *v = this->locals[i];
+      if (v->isDataseg() || v->nestedrefs.dim
+	  || (v->storage_class & (STCref | STCout | STClazy)))
+	return false;
+
+      for (size_t j = 0; j < this->uses.dim; j++)
+	{
+	  Expression *use = this->uses[j];
+	  if (((VarExp *) use)->var == v && !escape_member_p (&this->safe, use))
+	    return false;
+	}
+      return true;
+    }
+  return false;
+}
+
+/* Return true if a delegate to F may outlive the scanned function,
+   setting LOC to where it is made if known.  */
+
+bool
+EscapeScan::escapes (FuncDeclaration *f, Loc *loc)
+{
+  if (this->unknown)
+    return true;
+
+  for (size_t i = 0; i < this->leaked.dim; i++)
+    {
+      if (this->leaked[i] == f)
+	return true;
+    }
+
+  for (size_t i = 0; i < this->sites.dim; i++)
+    {
+      if (this->siteFuncs[i] == f && !this->isSafe (this->sites[i]))
+	{
+	  *loc = this->sites[i]->loc;
+	  return true;
+	}
+    }
+  return false;
+}
+
+/* Return true if the local variables of FD referenced by nested functions
+   have to live on the heap.  This is FuncDeclaration::needsClosure, except
+   that nested functions whose address is taken are scanned for whether
+   the delegates to them escape.  Why is reported with -Wclosure.  */
+
+bool
+IRState::needsClosure (FuncDeclaration *fd)
+{
+  EscapeScan *es = NULL;
+  FuncDeclaration *culprit = NULL;
+  const char *reason = NULL;
+  Loc loc = fd->loc;
+
+  for (size_t i = 0; i < fd->closureVars.dim && !culprit; i++)
+    {
+      VarDeclaration *v = fd->closureVars[i];
+
+      // A function referencing V, or any function below FD it is nested in,
+      // that is virtual or may escape.
+      for (size_t j = 0; j < v->nestedrefs.dim && !culprit; j++)
+	{
+	  for (Dsymbol *s = v->nestedrefs[j]; s && s != fd; s = s->parent)
+	    {
+	      FuncDeclaration *f = s->isFuncDeclaration();
+	      if (!f)
+		continue;
+
+	      if (f->isThis())
+		reason = "is a member function";
+	      else if (f->tookAddressOf)
+		{
+		  if (!es)
+		    {
+		      es = new EscapeScan (fd);
+		      es->scanFunction (fd);
+		    }
+		  if (es->escapes (f, &loc))
+		    reason = "may be called after it returns";
+		}
+
+	      if (reason)
+		{
+		  culprit = f;
+		  break;
+		}
+	    }
+	}
+    }
+
+  if (!reason && fd->closureVars.dim)
+    {
+      Type *tret = ((TypeFunction *) fd->type)->next->toBasetype();
+      if (tret->ty == Tclass || tret->ty == Tstruct)
+	{
+	  Dsymbol *st = tret->toDsymbol (NULL);
+	  for (Dsymbol *s = st->parent; s; s = s->parent)
+	    {
+	      if (s == fd)
+		{
+		  reason = "returns a nested type";
+		  break;
+		}
+	    }
+	}
+    }
+
+  if (reason && warn_closure)
+    {
+      location_t saved_location = input_location;
+      g.ofile->setLoc (loc);
+      if (culprit)
+	d_warning (OPT_Wclosure, "frame of '%s' is allocated on the heap: '%s' %s",
+		   fd->toPrettyChars(), culprit->toPrettyChars(), reason);
+      else
+	d_warning (OPT_Wclosure, "frame of '%s' is allocated on the heap: it %s",
+		   fd->toPrettyChars(), reason);
+      input_location = saved_location;
+    }
+
+  return reason != NULL;
+}
@@ -453,6 +453,253 @@ IdentityExp::toElem (IRState *irs)
     }
 }
 
+/* Equality of structs without opEquals, and of arrays of them or of
+   floating point values, is done in place instead of with memcmp or
+   _adEq2.  Fields and elements are compared one at a time, so floating
+   point values compare by value and the padding between fields is not
+   looked at.  Values that are equal exactly when their bytes are, such as
+   a struct of integers without padding, are compared a word at a time.
+   For the other structs, the frontend gives TypeInfo_Struct an
+   __xopEquals doing ==, so that _adEq2 and associative arrays agree.  */
+
+// Static arrays with more elements than this are compared in a loop.
+#define EQ_UNROLL_MAX 8
+
+/* Return true if the fields of struct SD overlap, as in a union.  */
+
+static bool
+eq_overlap_p (StructDeclaration *sd)
+{
+  unsigned end = 0;
+  for (size_t i = 0; i < sd->fields.dim; i++)
+    {
+      VarDeclaration *v = sd->fields[i];
+      if (v->offset < end)
+	return true;
+      end = v->offset + v->type->size();
+    }
+  return false;
+}
+
+/* Return true if values of type T are equal exactly when their bytes are.
+   Structs with overlapping fields are also compared by their bytes.  */
+
+static bool
+eq_bitwise_p (Type *t)
+{
+  t = t->toBasetype();
+  switch (t->ty)
+    {
+    case Tsarray:
+      return eq_bitwise_p (t->nextOf());
+
+    case Tstruct:
+      {
+	StructDeclaration *sd = ((TypeStruct *) t)->sym;
+	d_uns64 size = 0;
+
+	if (eq_overlap_p (sd))
+	  return true;
+
+	for (size_t i = 0; i < sd->fields.dim; i++)
+	  {
+	    VarDeclaration *v = sd->fields[i];
+	    if (!eq_bitwise_p (v->type))
+	      return false;
+	    size += v->type->size();
+	  }
+	return size == sd->structsize;
+      }
+
+    case Tpointer: case Tclass: case Tarray:
+    case Taarray: case Tdelegate:
+      return true;
+
+    case Tvector:
+      return false;
+
+    default:
+      return t->isintegral();
+    }
+}
+
+/* Return true if values of type T can be compared with build_eq.  */
+
+static bool
+eq_inline_p (Type *t)
+{
+  t = t->toBasetype();
+  switch (t->ty)
+    {
+    case Tsarray:
+      return eq_inline_p (t->nextOf());
+
+    case Tstruct:
+      {
+	StructDeclaration *sd = ((TypeStruct *) t)->sym;
+	// The __xopEquals of a struct without opEquals only does this.
+	if (search_function (sd, Id::eq))
+	  return false;
+	if (eq_overlap_p (sd))
+	  return true;
+
+	for (size_t i = 0; i < sd->fields.dim; i++)
+	  {
+	    if (!eq_inline_p (sd->fields[i]->type))
+	      return false;
+	  }
+	return true;
+      }
+
+    case Tvector:
+      return false;
+
+    default:
+      return t->isfloating() || eq_bitwise_p (t);
+    }
+}
+
+static tree build_eq_loop (IRState *irs, Type *telem, tree t_ptr1,
+			   tree t_ptr2, tree t_len);
+
+/* Return an expression that is true if T1 and T2, references to values
+   of type TYPE, are equal.  They are evaluated more than once.  */
+
+static tree
+build_eq (IRState *irs, Type *type, tree t1, tree t2)
+{
+  Type *tb = type->toBasetype();
+  HOST_WIDE_INT size = tb->size();
+
+  if (tb->isscalar() || tb->ty == Tclass)
+    return irs->boolOp (EQ_EXPR, t1, t2);
+
+  if (eq_bitwise_p (tb))
+    {
+      if (size > 4 * UNITS_PER_WORD)
+	{
+	  tree t_memcmp = irs->buildCall (d_built_in_decls (BUILT_IN_MEMCMP), 3,
+					  irs->addressOf (t1), irs->addressOf (t2),
+					  irs->integerConstant (size));
+	  return irs->boolOp (EQ_EXPR, t_memcmp, integer_zero_node);
+	}
+
+      // Compare the largest pieces that fit in a word.
+      tree result = NULL_TREE;
+      for (HOST_WIDE_INT offset = 0; offset < size; )
+	{
+	  HOST_WIDE_INT n = UNITS_PER_WORD;
+	  while (n > size - offset)
+	    n /= 2;
+
+	  tree t_int = d_type_for_size (n * BITS_PER_UNIT, 1);
+	  tree t_bits = bitsize_int (n * BITS_PER_UNIT);
+	  tree t_pos = bitsize_int (offset * BITS_PER_UNIT);
+	  tree t_cmp = irs->boolOp (EQ_EXPR,
+				    build3 (BIT_FIELD_REF, t_int, t1, t_bits, t_pos),
+				    build3 (BIT_FIELD_REF, t_int, t2, t_bits, t_pos));
+	  result = result ? irs->boolOp (TRUTH_ANDIF_EXPR, result, t_cmp) : t_cmp;
+	  offset += n;
+	}
+      return result ? result : boolean_true_node;
+    }
+
+  if (tb->ty == Tstruct)
+    {
+      StructDeclaration *sd = ((TypeStruct *) tb)->sym;
+      tree result = NULL_TREE;
+
+      for (size_t i = 0; i < sd->fields.dim; i++)
+	{
+	  VarDeclaration *v = sd->fields[i];
+	  tree t_field = v->toSymbol()->Stree;
+	  tree t_cmp = build_eq (irs, v->type, irs->component (t1, t_field),
+				 irs->component (t2, t_field));
+	  result = result ? irs->boolOp (TRUTH_ANDIF_EXPR, result, t_cmp) : t_cmp;
+	}
+      return result ? result : boolean_true_node;
+    }
+
+  gcc_assert (tb->ty == Tsarray);
+  Type *telem = tb->nextOf();
+  dinteger_t dim = ((TypeSArray *) tb)->dim->toInteger();
+
+  if (dim > EQ_UNROLL_MAX)
+    return build_eq_loop (irs, telem, irs->addressOf (t1), irs->addressOf (t2),
+			  size_int (dim));
+
+  tree t_elemtype = telem->toCtype();
+  HOST_WIDE_INT elem_size = telem->size();
+  tree result = NULL_TREE;
+
+  for (dinteger_t i = 0; i < dim; i++)
+    {
+      tree t_offset = size_int (i * elem_size);
+      tree t_cmp = build_eq (irs, telem,
+			     irs->indirect (irs->pointerOffset (irs->addressOf (t1), t_offset),
+					    t_elemtype),
+			     irs->indirect (irs->pointerOffset (irs->addressOf (t2), t_offset),
+					    t_elemtype));
+      result = result ? irs->boolOp (TRUTH_ANDIF_EXPR, result, t_cmp) : t_cmp;
+    }
+  return result ? result : boolean_true_node;
+}
+
+/* Return an expression that is true if the T_LEN elements of type TELEM
+   pointed to by T_PTR1 and T_PTR2 are equal.  */
+
+static tree
+build_eq_loop (IRState *irs, Type *telem, tree t_ptr1, tree t_ptr2, tree t_len)
+{
+  tree t_ptrtype = telem->pointerTo()->toCtype();
+
+  irs->pushStatementList();
+
+  tree t_result = irs->localVar (boolean_type_node);
+  DECL_INITIAL (t_result) = boolean_true_node;
+  irs->expandDecl (t_result);
+
+  irs->startBindings();
+
+  tree t_p1 = irs->localVar (t_ptrtype);
+  DECL_INITIAL (t_p1) = convert (t_ptrtype, t_ptr1);
+  irs->expandDecl (t_p1);
+
+  tree t_p2 = irs->localVar (t_ptrtype);
+  DECL_INITIAL (t_p2) = convert (t_ptrtype, t_ptr2);
+  irs->expandDecl (t_p2);
+
+  tree t_end = irs->localVar (t_ptrtype);
+  DECL_INITIAL (t_end) = irs->pointerIntSum (t_p1, t_len);
+  irs->expandDecl (t_end);
+
+  irs->startLoop (NULL);
+  irs->continueHere();
+  irs->exitIfFalse (build2 (NE_EXPR, boolean_type_node, t_p1, t_end));
+  irs->doExp (irs->vmodify (t_result, build_eq (irs, telem, irs->indirect (t_p1),
+						irs->indirect (t_p2))));
+  irs->exitIfFalse (t_result);
+  irs->doExp (irs->vmodify (t_p1, irs->pointerIntSum (t_p1, size_int (1))));
+  irs->doExp (irs->vmodify (t_p2, irs->pointerIntSum (t_p2, size_int (1))));
+  irs->endLoop();
+
+  irs->endBindings();
+  return irs->compound (irs->popStatementList(), t_result);
+}
+
+/* Return an expression that is true if E1 and E2, of type TYPE, are equal.
+   Both are evaluated once, left to right.  */
+
+static tree
+build_eq_exp (IRState *irs, Type *type, Expression *e1, Expression *e2)
+{
+  tree t1 = irs->maybeMakeTemp (irs->addressOf (e1->toElem (irs)));
+  tree t2 = irs->maybeMakeTemp (irs->addressOf (e2->toElem (irs)));
+  tree result = build_eq (irs, type, irs->indirect (t1), irs->indirect (t2));
+
+  return irs->compound (irs->compound (t1, t2), result);
+}
+
 elem *
 EqualExp::toElem (IRState *irs)
 {
@@ -464,11 +711,28 @@ EqualExp::toElem (IRState *irs)
     {
       Type *telem = tb1->nextOf()->toBasetype();
 
+      if (eq_inline_p (telem) && !eq_bitwise_p (telem))
+	{
+	  // Compare each element in place.
+	  tree t1 = irs->maybeMakeTemp (irs->toDArray (e1));
+	  tree t2 = irs->maybeMakeTemp (irs->toDArray (e2));
+	  tree t_len = irs->darrayLenRef (t1);
+	  tree result;
+
+	  result = irs->boolOp (TRUTH_ANDIF_EXPR,
+				irs->boolOp (EQ_EXPR, t_len, irs->darrayLenRef (t2)),
+				build_eq_loop (irs, telem, irs->darrayPtrRef (t1),
+					       irs->darrayPtrRef (t2), t_len));
+	  if (op == TOKnotequal)
+	    result = build1 (TRUTH_NOT_EXPR, boolean_type_node, result);
+	  return convert (type->toCtype(), result);
+	}
+
       // _adEq compares each element.  If bitwise comparison is ok,
       // use memcmp.
-      if (telem->isfloating() || telem->isClassHandle() ||
-	  telem->ty == Tsarray || telem->ty == Tarray ||
-	  telem->ty == Tstruct)
+      if (telem->isClassHandle() || telem->ty == Tarray
+	  || ((telem->ty == Tsarray || telem->ty == Tstruct)
+	      && !(eq_inline_p (telem) && eq_bitwise_p (telem))))
 	{
 	  tree result;
 	  tree args[3] = {
@@ -485,6 +749,15 @@ EqualExp::toElem (IRState *irs)
 	    result = build1 (TRUTH_NOT_EXPR, type->toCtype(), result);
 	  return result;
 	}
+      else if (tb1->ty == Tsarray && tb2->ty == Tsarray
+	       && (telem->ty == Tstruct || telem->ty == Tsarray))
+	{
+	  // Assuming sizes are equal.
+	  tree result = build_eq_exp (irs, tb1, e1, e2);
+	  if (op == TOKnotequal)
+	    result = build1 (TRUTH_NOT_EXPR, boolean_type_node, result);
+	  return convert (type->toCtype(), result);
+	}
       else if (tb1->ty == Tsarray && tb2->ty == Tsarray)
 	{
 	  // Assuming sizes are equal.
@@ -552,6 +825,13 @@ EqualExp::toElem (IRState *irs)
 
       return convert (type->toCtype(), result);
     }
+  else if (tb1->ty == Tstruct && eq_inline_p (tb1))
+    {
+      tree result = build_eq_exp (irs, tb1, e1, e2);
+      if (op == TOKnotequal)
+	result = build1 (TRUTH_NOT_EXPR, boolean_type_node, result);
+      return convert (type->toCtype(), result);
+    }
   else if (tb1->ty == Tstruct)
     {
       // Do bit compare of struct's
@@ -569,6 +849,272 @@ EqualExp::toElem (IRState *irs)
     }
 }
 
+/* With -finline-aa, lookups in associative arrays that don't insert are
+   done in place instead of calling _aaInp or _aaGetRvaluep, for keys whose
+   druntime TypeInfo has a simple getHash.  This mirrors the layout in
+   rt/aaA.d, which must be kept in sync:
+     struct AA  { BB *a; }
+     struct BB  { aaA*[] b; ... }
+     struct aaA { aaA *next; hash_t hash; key; value; }
+   where the value follows the key padded by aligntsize().  */
+
+static bool
+aa_inline_key_p (Type *key_type)
+{
+  switch (key_type->ty)
+    {
+    case Tint8: case Tuns8: case Tint16: case Tuns16:
+    case Tint32: case Tuns32: case Tint64: case Tuns64:
+    case Tchar: case Twchar: case Tdchar:
+    case Tpointer:
+      return true;
+
+    case Tarray:
+      // Only string has its own TypeInfo, mutable and const char[] keys
+      // are hashed by TypeInfo_Array with hashOf.
+      return !key_type->mod && key_type->nextOf()->ty == Tchar
+	&& key_type->nextOf()->isImmutable();
+
+    default:
+      return false;
+    }
+}
+
+/* Build the statements to set T_HASH to hashOf() of the 8 bytes of the
+   value in T_KEY, as getHash of TypeInfo_l and TypeInfo_m does.  */
+
+static void
+build_aa_hashof8 (IRState *irs, tree t_hash, tree t_key)
+{
+  tree t_hashtype = TREE_TYPE (t_hash);
+  tree t_bits = convert (Type::tuns64->toCtype(), t_key);
+  tree t_half[4];
+
+  // The 16 bit halves in memory order.
+  for (int i = 0; i < 4; i++)
+    {
+      int shift = BYTES_BIG_ENDIAN ? 56 - 16 * i : 16 * i;
+      tree t_lo = build2 (RSHIFT_EXPR, TREE_TYPE (t_bits), t_bits,
+			  build_int_cst (integer_type_node, shift));
+      tree t_hi = build2 (RSHIFT_EXPR, TREE_TYPE (t_bits), t_bits,
+			  build_int_cst (integer_type_node,
+					 BYTES_BIG_ENDIAN ? shift - 8 : shift + 8));
+      t_lo = build2 (BIT_AND_EXPR, TREE_TYPE (t_bits), t_lo,
+		     build_int_cst (TREE_TYPE (t_bits), 0xff));
+      t_hi = build2 (BIT_AND_EXPR, TREE_TYPE (t_bits), t_hi,
+		     build_int_cst (TREE_TYPE (t_bits), 0xff));
+      t_half[i] = convert (t_hashtype,
+			   build2 (BIT_IOR_EXPR, TREE_TYPE (t_bits), t_lo,
+				   build2 (LSHIFT_EXPR, TREE_TYPE (t_bits), t_hi,
+					   build_int_cst (integer_type_node, 8))));
+    }
+
+  irs->doExp (irs->vmodify (t_hash, build_int_cst (t_hashtype, 0)));
+  for (int i = 0; i < 4; i += 2)
+    {
+      tree t_tmp;
+      irs->doExp (irs->vmodify (t_hash, build2 (PLUS_EXPR, t_hashtype,
+						t_hash, t_half[i])));
+      t_tmp = build2 (BIT_XOR_EXPR, t_hashtype, t_hash,
+		      build2 (LSHIFT_EXPR, t_hashtype, t_half[i + 1],
+			      build_int_cst (integer_type_node, 11)));
+      irs->doExp (irs->vmodify (t_hash, build2 (BIT_XOR_EXPR, t_hashtype,
+						build2 (LSHIFT_EXPR, t_hashtype, t_hash,
+							build_int_cst (integer_type_node, 16)),
+						t_tmp)));
+      irs->doExp (irs->vmodify (t_hash, build2 (PLUS_EXPR, t_hashtype, t_hash,
+						build2 (RSHIFT_EXPR, t_hashtype, t_hash,
+							build_int_cst (integer_type_node, 11)))));
+    }
+
+  // Force "avalanching" of the final bits.
+  static const struct { tree_code code, shift_code; int shift; } avalanche[] =
+  {
+    { BIT_XOR_EXPR, LSHIFT_EXPR, 3 },
+    { PLUS_EXPR, RSHIFT_EXPR, 5 },
+    { BIT_XOR_EXPR, LSHIFT_EXPR, 4 },
+    { PLUS_EXPR, RSHIFT_EXPR, 17 },
+    { BIT_XOR_EXPR, LSHIFT_EXPR, 25 },
+    { PLUS_EXPR, RSHIFT_EXPR, 6 },
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE (avalanche); i++)
+    {
+      tree t_shift = build2 (avalanche[i].shift_code, t_hashtype, t_hash,
+			     build_int_cst (integer_type_node, avalanche[i].shift));
+      irs->doExp (irs->vmodify (t_hash, build2 (avalanche[i].code, t_hashtype,
+						t_hash, t_shift)));
+    }
+}
+
+/* Build the statements to set T_HASH to getHash of the TypeInfo for
+   KEY_TYPE applied to the key in T_KEY.  */
+
+static void
+build_aa_key_hash (IRState *irs, Type *key_type, tree t_hash, tree t_key)
+{
+  tree t_hashtype = TREE_TYPE (t_hash);
+
+  switch (key_type->ty)
+    {
+    case Tint32:
+      // TypeInfo_i hashes the bits of the value, it is not sign extended.
+      irs->doExp (irs->vmodify (t_hash, convert (t_hashtype,
+						 convert (Type::tuns32->toCtype(),
+							  t_key))));
+      break;
+
+    case Tint64:
+    case Tuns64:
+      build_aa_hashof8 (irs, t_hash, t_key);
+      break;
+
+    case Tarray:
+      {
+	// hash = hash * 11 + c, for each char.
+	tree t_ptrtype = key_type->nextOf()->pointerTo()->toCtype();
+	tree t_ptr = irs->localVar (t_ptrtype);
+	tree t_end = irs->localVar (t_ptrtype);
+
+	DECL_INITIAL (t_ptr) = irs->darrayPtrRef (t_key);
+	irs->expandDecl (t_ptr);
+	DECL_INITIAL (t_end) = irs->pointerOffset (t_ptr, irs->darrayLenRef (t_key));
+	irs->expandDecl (t_end);
+	irs->doExp (irs->vmodify (t_hash, build_int_cst (t_hashtype, 0)));
+
+	irs->startLoop (NULL);
+	irs->continueHere();
+	irs->exitIfFalse (build2 (NE_EXPR, boolean_type_node, t_ptr, t_end));
+	irs->doExp (irs->vmodify (t_hash,
+				  build2 (PLUS_EXPR, t_hashtype,
+					  build2 (MULT_EXPR, t_hashtype, t_hash,
+						  build_int_cst (t_hashtype, 11)),
+					  convert (t_hashtype, irs->indirect (t_ptr)))));
+	irs->doExp (irs->vmodify (t_ptr, irs->pointerOffset (t_ptr, size_int (1))));
+	irs->endLoop();
+	break;
+      }
+
+    default:
+      irs->doExp (irs->vmodify (t_hash, convert (t_hashtype, t_key)));
+      break;
+    }
+}
+
+/* Return an expression that looks up the key in T_KEY, of type KEY_TYPE,
+   in the associative array T_AA.  The result is a void pointer to the
+   value, or null if the key is not in the array, same as _aaInp.  */
+
+static tree
+build_aa_lookup (IRState *irs, tree t_aa, Type *key_type, tree t_key)
+{
+  tree t_hashtype = Type::tsize_t->toCtype();
+  HOST_WIDE_INT ptrsize = int_size_in_bytes (ptr_type_node);
+  HOST_WIDE_INT keysize = key_type->size();
+  HOST_WIDE_INT valalign;
+
+  // Logic copied from aligntsize() in rt/aaA.d, D_LP64 as set by d_init.
+  if (TYPE_PRECISION (long_integer_type_node) == 64
+      && TYPE_PRECISION (integer_type_node) == 32 && POINTER_SIZE == 64)
+    valalign = 16;
+  else
+    valalign = ptrsize;
+  HOST_WIDE_INT valoffset = 2 * ptrsize + ((keysize + valalign - 1) & ~(valalign - 1));
+
+  irs->pushStatementList();
+
+  tree t_entry = irs->localVar (ptr_type_node);
+  DECL_INITIAL (t_entry) = null_pointer_node;
+  irs->expandDecl (t_entry);
+
+  irs->startBindings();
+
+  tree t_keyvar = irs->localVar (key_type);
+  DECL_INITIAL (t_keyvar) = t_key;
+  irs->expandDecl (t_keyvar);
+
+  tree t_bb = irs->localVar (ptr_type_node);
+  DECL_INITIAL (t_bb) = irs->vconvert (t_aa, ptr_type_node);
+  irs->expandDecl (t_bb);
+
+  // The buckets, only looked at when the array is not empty.
+  irs->pushStatementList();
+
+  tree t_len = irs->localVar (Type::tsize_t);
+  DECL_INITIAL (t_len) = irs->indirect (t_bb, t_hashtype);
+  irs->expandDecl (t_len);
+
+  irs->pushStatementList();
+
+  tree t_hash = irs->localVar (Type::tsize_t);
+  irs->expandDecl (t_hash);
+  build_aa_key_hash (irs, key_type, t_hash, t_keyvar);
+
+  tree t_buckets = irs->indirect (irs->pointerOffset (t_bb, size_int (ptrsize)),
+				  ptr_type_node);
+  tree t_index = build2 (MULT_EXPR, sizetype,
+			 convert (sizetype, build2 (TRUNC_MOD_EXPR, t_hashtype,
+						    t_hash, t_len)),
+			 size_int (ptrsize));
+  irs->doExp (irs->vmodify (t_entry,
+			    irs->indirect (irs->pointerOffset (t_buckets, t_index),
+					   ptr_type_node)));
+
+  // Walk the chain until an entry with the same hash and key.
+  tree t_ehash = irs->indirect (irs->pointerOffset (t_entry, size_int (ptrsize)),
+				t_hashtype);
+  tree t_ekey = irs->indirect (irs->pointerOffset (t_entry, size_int (2 * ptrsize)),
+			       key_type->toCtype());
+  tree t_match;
+
+  if (key_type->ty == Tarray)
+    {
+      tree t_klen = irs->darrayLenRef (t_keyvar);
+      tree t_memcmp = irs->buildCall (d_built_in_decls (BUILT_IN_MEMCMP), 3,
+				      irs->darrayPtrRef (t_ekey),
+				      irs->darrayPtrRef (t_keyvar), t_klen);
+      t_match = build2 (TRUTH_ANDIF_EXPR, boolean_type_node,
+			build2 (EQ_EXPR, boolean_type_node,
+				irs->darrayLenRef (t_ekey), t_klen),
+			build2 (EQ_EXPR, boolean_type_node, t_memcmp,
+				integer_zero_node));
+    }
+  else
+    t_match = build2 (EQ_EXPR, boolean_type_node, t_ekey, t_keyvar);
+
+  t_match = build2 (TRUTH_ANDIF_EXPR, boolean_type_node,
+		    build2 (EQ_EXPR, boolean_type_node, t_ehash, t_hash), t_match);
+
+  irs->startLoop (NULL);
+  irs->continueHere();
+  irs->exitIfFalse (build2 (NE_EXPR, boolean_type_node, t_entry,
+			    null_pointer_node));
+  irs->exitIfFalse (build1 (TRUTH_NOT_EXPR, boolean_type_node, t_match));
+  irs->doExp (irs->vmodify (t_entry, irs->indirect (t_entry, ptr_type_node)));
+  irs->endLoop();
+
+  tree t_probe = irs->popStatementList();
+  irs->doExp (build3 (COND_EXPR, void_type_node,
+		      build2 (NE_EXPR, boolean_type_node, t_len,
+			      build_int_cst (t_hashtype, 0)),
+		      t_probe, NULL_TREE));
+
+  tree t_nonempty = irs->popStatementList();
+  irs->doExp (build3 (COND_EXPR, void_type_node,
+		      build2 (NE_EXPR, boolean_type_node, t_bb, null_pointer_node),
+		      t_nonempty, NULL_TREE));
+
+  irs->endBindings();
+  tree t_body = irs->popStatementList();
+
+  tree t_result = build3 (COND_EXPR, ptr_type_node,
+			  build2 (NE_EXPR, boolean_type_node, t_entry,
+				  null_pointer_node),
+			  irs->pointerOffset (t_entry, size_int (valoffset)),
+			  null_pointer_node);
+  return irs->compound (t_body, t_result);
+}
+
 elem *
 InExp::toElem (IRState *irs)
 {
@@ -577,6 +1123,13 @@ InExp::toElem (IRState *irs)
   gcc_assert (e2_base_type->ty == Taarray);
 
   Type *key_type = ((TypeAArray *) e2_base_type)->index->toBasetype();
+  if (gen.inlineAA && aa_inline_key_p (key_type))
+    {
+      return d_convert_basic (type->toCtype(),
+			      build_aa_lookup (irs, e2->toElem (irs), key_type,
+					       irs->convertTo (e1, key_type)));
+    }
+
   tree args[3] = {
       e2->toElem (irs),
       irs->typeinfoReference (key_type),
@@ -786,6 +1339,21 @@ PowExp::toElem (IRState *irs)
   return convert (type->toCtype(), irs->buildCall (powfn, 2, e1_t, e2_t));
 }
 
+// Determine if type is an array of structs that need a postblit.
+static StructDeclaration *
+needsPostblit (Type *t)
+{
+  t = t->toBasetype();
+  while (t->ty == Tsarray)
+    t = t->nextOf()->toBasetype();
+  if (t->ty == Tstruct)
+    {   StructDeclaration *sd = ((TypeStruct *)t)->sym;
+      if (sd->postblit)
+	return sd;
+    }
+  return NULL;
+}
+
 static tree
 one_elem_array (IRState *irs, Expression *value, tree& var_decl_out)
 {
@@ -793,6 +1361,112 @@ one_elem_array (IRState *irs, Expression *value, tree& var_decl_out)
   return irs->darrayVal (value->type->arrayOf(), 1, irs->addressOf (v));
 }
 
+/* Concatenate OPS, each either an array or a single element of ELEM_TYPE,
+   into a new array of TYPE.  Instead of passing them all to _d_arraycatnT,
+   the total length is summed up inline, the array allocated with
+   _d_arrayliteralTp, and the operands copied or stored into it.  */
+
+static tree
+build_cat_inline (IRState *irs, Type *type, Type *elem_type, Expressions *ops)
+{
+  size_t n_ops = ops->dim;
+  tree *vals = new tree[n_ops];
+  tree *lens = new tree[n_ops];	// NULL_TREE for single elements
+  tree size_type = Type::tsize_t->toCtype();
+  tree elem_size = irs->integerConstant (elem_type->size(), Type::tsize_t);
+  tree zero = irs->integerConstant (0, Type::tsize_t);
+  tree one = irs->integerConstant (1, Type::tsize_t);
+  tree len = zero;
+  tree result = NULL_TREE;
+
+  // Operands before the last one with side effects are copied into
+  // temporaries, even if they are only variables, as in 's ~ f()' where
+  // f assigns to s.
+  size_t n_saved = 0;
+  for (size_t i = 0; i < n_ops; i++)
+    {
+      Expression *oe = (*ops)[i];
+
+      if (irs->typesCompatible (oe->type->toBasetype(), elem_type->toBasetype()))
+	{
+	  vals[i] = irs->convertTo (oe, elem_type);
+	  lens[i] = NULL_TREE;
+	}
+      else
+	{
+	  vals[i] = irs->toDArray (oe);
+	  lens[i] = vals[i];
+	}
+
+      if (TREE_SIDE_EFFECTS (vals[i]))
+	n_saved = i;
+    }
+
+  // Evaluate the operands left to right, before allocating.
+  for (size_t i = 0; i < n_ops; i++)
+    {
+      if (i < n_saved && ! TREE_CONSTANT (vals[i]))
+	{
+	  tree var = irs->localVar (TREE_TYPE (vals[i]));
+	  result = irs->maybeCompound (result, irs->vinit (var, vals[i]));
+	  vals[i] = var;
+	}
+      else
+	vals[i] = irs->maybeMakeTemp (vals[i]);
+
+      if (! lens[i])
+	{
+	  result = irs->maybeCompound (result, vals[i]);
+	  len = fold_build2 (PLUS_EXPR, size_type, len, one);
+	}
+      else
+	{
+	  lens[i] = irs->maybeMakeTemp (fold_convert (size_type,
+						      irs->darrayLenRef (vals[i])));
+	  result = irs->maybeCompound (result, lens[i]);
+	  len = fold_build2 (PLUS_EXPR, size_type, len, lens[i]);
+	}
+    }
+
+  len = irs->maybeMakeTemp (len);
+  tree args[2] = { irs->typeinfoReference (type), len };
+  tree mem = irs->libCall (LIBCALL_ARRAYLITERALTP, 2, args,
+			   elem_type->pointerTo()->toCtype());
+  mem = irs->maybeMakeTemp (mem);
+  result = irs->maybeCompound (result, mem);
+
+  tree offset = zero;
+  for (size_t i = 0; i < n_ops; i++)
+    {
+      tree dest = irs->pointerIntSum (mem, offset);
+      tree copy;
+
+      if (! lens[i])
+	{
+	  copy = irs->vmodify (irs->indirect (dest), vals[i]);
+	  offset = fold_build2 (PLUS_EXPR, size_type, offset, one);
+	}
+      else
+	{
+	  tree size = fold_build2 (MULT_EXPR, size_type, lens[i], elem_size);
+	  copy = irs->buildCall (d_built_in_decls (BUILT_IN_MEMCPY), 3, dest,
+				 irs->darrayPtrRef (vals[i]), size);
+	  // Both pointers may be null when there is nothing to copy.
+	  copy = fold_build3 (COND_EXPR, void_type_node,
+			      fold_build2 (NE_EXPR, boolean_type_node,
+					   lens[i], zero),
+			      copy, d_void_zero_node);
+	  offset = fold_build2 (PLUS_EXPR, size_type, offset, lens[i]);
+	}
+      result = irs->compound (result, copy);
+    }
+
+  delete[] vals;
+  delete[] lens;
+
+  return irs->compound (result, irs->darrayVal (type->toCtype(), len, mem));
+}
+
 elem *
 CatExp::toElem (IRState *irs)
 {
@@ -834,6 +1508,25 @@ CatExp::toElem (IRState *irs)
 	}
     }
 
+  // When optimizing, do it inline unless the runtime has to run postblits.
+  if (optimize && !optimize_size
+      && elem_type->toBasetype()->ty != Tvoid && !needsPostblit (elem_type))
+    {
+      Expressions ops;
+      CatExp *ce = this;
+
+      ops.setDim (n_operands);
+      for (unsigned i = n_operands - 1; i > 0; i--)
+	{
+	  ops[i] = ce->e2;
+	  if (i > 1)
+	    ce = (CatExp *) ce->e1;
+	}
+      ops[0] = ce->e1;
+
+      return build_cat_inline (irs, type, elem_type, &ops);
+    }
+
   n_args = 1 + (n_operands > 2 ? 1 : 0) +
     n_operands * (n_operands > 2 && irs->splitDynArrayVarArgs ? 2 : 1);
   args = new tree[n_args];
@@ -1155,21 +1848,6 @@ array_set_expr (IRState *irs, tree ptr, tree src, tree count)
   return irs->popStatementList();
 }
 
-// Determine if type is an array of structs that need a postblit.
-static StructDeclaration *
-needsPostblit (Type *t)
-{
-  t = t->toBasetype();
-  while (t->ty == Tsarray)
-    t = t->nextOf()->toBasetype();
-  if (t->ty == Tstruct)
-    {   StructDeclaration *sd = ((TypeStruct *)t)->sym;
-      if (sd->postblit)
-	return sd;
-    }
-  return NULL;
-}
-
 
 elem *
 AssignExp::toElem (IRState *irs)
@@ -1376,16 +2054,27 @@ IndexExp::toElem (IRState *irs)
   else
     {
       Type *key_type = ((TypeAArray *) array_type)->index->toBasetype();
-      AddrOfExpr aoe;
-      tree args[4] = {
-	  e1->toElem (irs),
-	  irs->typeinfoReference (key_type),
-	  irs->integerConstant (array_type->nextOf()->size(), Type::tsize_t),
-	  aoe.set (irs, irs->convertTo (e2, key_type))
-      };
-      LibCall lib_call = modifiable ? LIBCALL_AAGETP : LIBCALL_AAGETRVALUEP;
-      tree t = irs->libCall (lib_call, 4, args, type->pointerTo()->toCtype());
-      t = aoe.finish (irs, t);
+      tree t;
+
+      if (!modifiable && gen.inlineAA && aa_inline_key_p (key_type))
+	{
+	  t = build_aa_lookup (irs, e1->toElem (irs), key_type,
+			       irs->convertTo (e2, key_type));
+	  t = d_convert_basic (type->pointerTo()->toCtype(), t);
+	}
+      else
+	{
+	  AddrOfExpr aoe;
+	  tree args[4] = {
+	      e1->toElem (irs),
+	      irs->typeinfoReference (key_type),
+	      irs->integerConstant (array_type->nextOf()->size(), Type::tsize_t),
+	      aoe.set (irs, irs->convertTo (e2, key_type))
+	  };
+	  LibCall lib_call = modifiable ? LIBCALL_AAGETP : LIBCALL_AAGETRVALUEP;
+	  t = irs->libCall (lib_call, 4, args, type->pointerTo()->toCtype());
+	  t = aoe.finish (irs, t);
+	}
 
       if (irs->arrayBoundsCheck())
 	{
@@ -1490,18 +2179,21 @@ SliceExp::toElem (IRState *irs)
 
       if (irs->arrayBoundsCheck())
 	{
+	  bool upr_ok, lwr_ok;
+	  irs->sliceInBounds (this, &upr_ok, &lwr_ok);
+
 	  // %% && ! is zero
-	  if (array_len_expr)
+	  if (array_len_expr && !upr_ok)
 	    {
 	      final_len_expr = irs->checkedIndex (loc, upr_tree, array_len_expr, true);
 	    }
 	  else
 	    {
 	      // Still need to check bounds lwr <= upr for pointers.
-	      gcc_assert (orig_array_type->ty == Tpointer);
+	      gcc_assert (orig_array_type->ty == Tpointer || upr_ok);
 	      final_len_expr = upr_tree;
 	    }
-	  if (lwr_tree)
+	  if (lwr_tree && !lwr_ok)
 	    {
 	      // Enforces lwr <= upr. No need to check lwr <= length as
 	      // we've already ensured that upr <= length.
@@ -1815,9 +2507,434 @@ AddrExp::toElem (IRState *irs)
   return irs->nop (irs->addressOf (e1->toElem (irs)), type->toCtype());
 }
 
+/* Array operations such as a[] = b[] * c + d[] are lowered by the
+   frontend to a call to an _array function, named after the operation in
+   RPN order, whose arguments are the operands in reverse order (see
+   BinExp::arrayOp).  When optimizing, the operation is instead expanded
+   in place from the name, so the loop is optimized with its caller.  */
+
+#define MAX_INLINE_ARRAYOP_TOKENS 16
+
+enum arrayop_kind
+{
+  AOslice,		// array operand
+  AOexp,		// scalar operand
+  AOunary,
+  AObinary,
+  AOassign		// e1[] = e2, or e1[] op= e2 when code is set
+};
+
+struct arrayop_token
+{
+  arrayop_kind kind;
+  tree_code code;
+  size_t arg;		// index into arguments for operands
+};
+
+static const struct
+{
+  const char *name;
+  tree_code code;
+} arrayop_ops[] =
+{
+  { "Add", PLUS_EXPR },
+  { "Min", MINUS_EXPR },
+  { "Mul", MULT_EXPR },
+  { "Div", TRUNC_DIV_EXPR },
+  { "Mod", TRUNC_MOD_EXPR },
+  { "Xor", BIT_XOR_EXPR },
+  { "And", BIT_AND_EXPR },
+  { "Or", BIT_IOR_EXPR },
+};
+
+/* Return true if values of type T can take part in an inline array
+   operation.  */
+
+static bool
+arrayop_scalar_p (Type *t)
+{
+  t = t->toBasetype();
+  return (t->isintegral() && t->ty != Tbool) || t->isreal();
+}
+
+/* Decode the array operation called by CE into TOKENS.  Returns the
+   number of tokens, or 0 if the call should not be expanded.  */
+
+static size_t
+arrayop_tokens (CallExp *ce, arrayop_token *tokens)
+{
+  if (ce->e1->op != TOKvar)
+    return 0;
+
+  FuncDeclaration *fd = ((VarExp *) ce->e1)->var->isFuncDeclaration();
+  if (!fd || fd->linkage != LINKc || strncmp (fd->ident->string, "_array", 6) != 0)
+    return 0;
+
+  Type *tb = ce->type->toBasetype();
+  if (tb->ty != Tarray || !arrayop_scalar_p (tb->nextOf()))
+    return 0;
+
+  Expressions *args = ce->arguments;
+  const char *p = fd->ident->string + 6;
+  size_t ntokens = 0;
+  size_t nargs = 0;
+  size_t depth = 0;
+
+  while (*p != '_')
+    {
+      if (ntokens == MAX_INLINE_ARRAYOP_TOKENS)
+	return 0;
+
+      arrayop_token *t = &tokens[ntokens++];
+      t->code = ERROR_MARK;
+      t->arg = 0;
+
+      if (strncmp (p, "Slice", 5) == 0 || strncmp (p, "Exp", 3) == 0)
+	{
+	  t->kind = (*p == 'S') ? AOslice : AOexp;
+	  p += (*p == 'S') ? 5 : 3;
+
+	  // Operands are passed in the reverse of the order they appear.
+	  if (!args || nargs == args->dim)
+	    return 0;
+	  t->arg = args->dim - ++nargs;
+
+	  Type *targ = args->tdata()[t->arg]->type->toBasetype();
+	  if (t->kind == AOslice)
+	    {
+	      if (targ->ty != Tarray || !arrayop_scalar_p (targ->nextOf()))
+		return 0;
+	    }
+	  else if (!arrayop_scalar_p (targ))
+	    return 0;
+	  depth++;
+	  continue;
+	}
+
+      if (strncmp (p, "Assign", 6) == 0)
+	{
+	  t->kind = AOassign;
+	  p += 6;
+	}
+      else if (strncmp (p, "Neg", 3) == 0 || strncmp (p, "Com", 3) == 0)
+	{
+	  t->kind = AOunary;
+	  t->code = (*p == 'N') ? NEGATE_EXPR : BIT_NOT_EXPR;
+	  p += 3;
+	  if (depth < 1)
+	    return 0;
+	  continue;
+	}
+      else
+	{
+	  size_t i;
+	  for (i = 0; i < ARRAY_SIZE (arrayop_ops); i++)
+	    {
+	      size_t len = strlen (arrayop_ops[i].name);
+	      if (strncmp (p, arrayop_ops[i].name, len) == 0)
+		{
+		  p += len;
+		  break;
+		}
+	    }
+	  // Pow is left to the library.
+	  if (i == ARRAY_SIZE (arrayop_ops))
+	    return 0;
+
+	  t->code = arrayop_ops[i].code;
+	  if (strncmp (p, "ass", 3) == 0)
+	    {
+	      t->kind = AOassign;
+	      p += 3;
+	    }
+	  else
+	    t->kind = AObinary;
+	}
+
+      if (depth < 2)
+	return 0;
+      depth--;
+      // The destination of an assignment is the last operand, args[0].
+      if (t->kind == AOassign
+	  && (tokens[ntokens - 2].kind != AOslice || tokens[ntokens - 2].arg != 0
+	      || p[0] != '_'))
+	return 0;
+    }
+
+  if (ntokens < 3 || tokens[ntokens - 1].kind != AOassign
+      || depth != 1 || !args || nargs != args->dim)
+    return 0;
+
+  return ntokens;
+}
+
+/* Type to compute elements of type T in, integers smaller than int are
+   promoted as they are in the generated function.  */
+
+static Type *
+arrayop_compute_type (Type *t)
+{
+  t = t->toBasetype();
+  if (t->isintegral() && t->size() < Type::tint32->size())
+    return Type::tint32;
+  return t;
+}
+
+/* Build CODE applied to LHS and RHS, computed in type TCOMP.  */
+
+static tree
+build_arrayop_binary (IRState *irs, Type *tcomp, tree_code code,
+		      tree lhs, tree rhs)
+{
+  tree t_comp = tcomp->toCtype();
+
+  if (tcomp->isreal())
+    {
+      if (code == TRUNC_MOD_EXPR)
+	return irs->floatMod (lhs, rhs, t_comp);
+      if (code == TRUNC_DIV_EXPR)
+	code = RDIV_EXPR;
+    }
+  return fold_build2 (code, t_comp, lhs, rhs);
+}
+
+/* Build the statement for element INDEX of the array operation in TOKENS.
+   PTRS and VALS hold the pointer of every array operand and the value of
+   every scalar operand, indexed the same as the arguments.  */
+
+static tree
+build_arrayop_elem (IRState *irs, CallExp *ce, arrayop_token *tokens,
+		    size_t ntokens, tree *ptrs, tree *vals, tree index)
+{
+  Type *tcomp = arrayop_compute_type (ce->type->toBasetype()->nextOf());
+  tree t_comp = tcomp->toCtype();
+  tree stack[MAX_INLINE_ARRAYOP_TOKENS];
+  size_t sp = 0;
+
+  for (size_t i = 0; i < ntokens; i++)
+    {
+      arrayop_token *t = &tokens[i];
+      switch (t->kind)
+	{
+	case AOslice:
+	  stack[sp++] = irs->indirect (irs->pointerIntSum (ptrs[t->arg], index));
+	  break;
+
+	case AOexp:
+	  stack[sp++] = vals[t->arg];
+	  break;
+
+	case AOunary:
+	  stack[sp - 1] = fold_build1 (t->code, t_comp,
+				       convert (t_comp, stack[sp - 1]));
+	  break;
+
+	case AObinary:
+	  {
+	    tree t_rhs = convert (t_comp, stack[--sp]);
+	    tree t_lhs = convert (t_comp, stack[--sp]);
+	    stack[sp++] = build_arrayop_binary (irs, tcomp, t->code, t_lhs, t_rhs);
+	    break;
+	  }
+
+	case AOassign:
+	  {
+	    // Assignments are evaluated right to left, the destination
+	    // element is on top of the value.
+	    tree t_dest = stack[--sp];
+	    tree t_val = convert (t_comp, stack[--sp]);
+	    if (t->code != ERROR_MARK)
+	      t_val = build_arrayop_binary (irs, tcomp, t->code,
+					    convert (t_comp, t_dest), t_val);
+	    return irs->vmodify (t_dest, convert (TREE_TYPE (t_dest), t_val));
+	  }
+	}
+    }
+  gcc_unreachable();
+}
+
+/* Return true if the array operands in TOKENS are slices of distinct
+   static arrays, so cannot overlap.  */
+
+static bool
+arrayop_disjoint_p (CallExp *ce, arrayop_token *tokens, size_t ntokens)
+{
+  VarDeclaration *vars[MAX_INLINE_ARRAYOP_TOKENS];
+  size_t nvars = 0;
+
+  for (size_t i = 0; i < ntokens; i++)
+    {
+      if (tokens[i].kind != AOslice)
+	continue;
+
+      Expression *e = ce->arguments->tdata()[tokens[i].arg];
+      if (e->op != TOKslice || ((SliceExp *) e)->e1->op != TOKvar)
+	return false;
+
+      VarDeclaration *v = ((VarExp *) ((SliceExp *) e)->e1)->var->isVarDeclaration();
+      if (!v || v->type->toBasetype()->ty != Tsarray || v->isRef()
+	  || (v->storage_class & STCout))
+	return false;
+
+      for (size_t j = 0; j < nvars; j++)
+	{
+	  if (vars[j] == v)
+	    return false;
+	}
+      vars[nvars++] = v;
+    }
+  return nvars > 1;
+}
+
+/* Number of elements of type T the vectorizer works on at once.  */
+
+static unsigned
+arrayop_unroll (Type *t)
+{
+  enum machine_mode mode = TYPE_MODE (t->toCtype());
+  enum machine_mode vmode = targetm.vectorize.preferred_simd_mode (mode);
+
+  if (!VECTOR_MODE_P (vmode))
+    return 1;
+  return MIN (GET_MODE_NUNITS (vmode), 8);
+}
+
+/* Expand the array operation called by CE in place.  The elements are
+   done in groups of a vector's worth, which the SLP vectorizer packs
+   into vector instructions, then the remainder one at a time.  */
+
+static tree
+build_arrayop (IRState *irs, CallExp *ce, arrayop_token *tokens, size_t ntokens)
+{
+  Expressions *args = ce->arguments;
+  bool *slice_p = (bool *) alloca (args->dim * sizeof (bool));
+  tree *ptrs = (tree *) alloca (args->dim * sizeof (tree));
+  tree *vals = (tree *) alloca (args->dim * sizeof (tree));
+  tree *lens = (tree *) alloca (args->dim * sizeof (tree));
+  bool restrict_p = arrayop_disjoint_p (ce, tokens, ntokens);
+  Type *telem = ce->type->toBasetype()->nextOf()->toBasetype();
+  tree t_sizetype = Type::tsize_t->toCtype();
+
+  for (size_t i = 0; i < ntokens; i++)
+    {
+      if (tokens[i].kind == AOslice || tokens[i].kind == AOexp)
+	slice_p[tokens[i].arg] = (tokens[i].kind == AOslice);
+    }
+
+  irs->pushStatementList();
+
+  // The result is the destination, which is the first argument.
+  tree t_dest = args->tdata()[0]->toElem (irs);
+  tree t_result = irs->localVar (TREE_TYPE (t_dest));
+  DECL_INITIAL (t_result) = t_dest;
+  irs->expandDecl (t_result);
+
+  irs->startBindings();
+
+  tree t_len = irs->localVar (Type::tsize_t);
+  DECL_INITIAL (t_len) = irs->darrayLenRef (t_result);
+  irs->expandDecl (t_len);
+
+  for (size_t i = 0; i < args->dim; i++)
+    {
+      Expression *arg = args->tdata()[i];
+      tree t_arg = (i == 0) ? t_result : arg->toElem (irs);
+
+      ptrs[i] = vals[i] = lens[i] = NULL_TREE;
+      if (slice_p[i])
+	{
+	  tree t_ptrtype = arg->type->toBasetype()->nextOf()->pointerTo()->toCtype();
+	  if (restrict_p)
+	    t_ptrtype = build_qualified_type (t_ptrtype, TYPE_QUAL_RESTRICT);
+
+	  if (i != 0)
+	    {
+	      tree t_arr = irs->localVar (TREE_TYPE (t_arg));
+	      DECL_INITIAL (t_arr) = t_arg;
+	      irs->expandDecl (t_arr);
+	      t_arg = t_arr;
+	      lens[i] = irs->darrayLenRef (t_arr);
+	    }
+	  ptrs[i] = irs->localVar (t_ptrtype);
+	  DECL_INITIAL (ptrs[i]) = convert (t_ptrtype, irs->darrayPtrRef (t_arg));
+	  irs->expandDecl (ptrs[i]);
+	}
+      else
+	{
+	  vals[i] = irs->localVar (TREE_TYPE (t_arg));
+	  DECL_INITIAL (vals[i]) = t_arg;
+	  irs->expandDecl (vals[i]);
+	}
+    }
+
+  // All array operands must be the same length as the destination.
+  if (irs->arrayBoundsCheck())
+    {
+      for (size_t i = 1; i < args->dim; i++)
+	{
+	  if (!lens[i])
+	    continue;
+	  irs->doExp (build3 (COND_EXPR, void_type_node,
+			      build2 (NE_EXPR, boolean_type_node, lens[i], t_len),
+			      irs->assertCall (ce->loc, LIBCALL_ARRAY_BOUNDS),
+			      NULL_TREE));
+	}
+    }
+
+  tree t_index = irs->localVar (Type::tsize_t);
+  DECL_INITIAL (t_index) = irs->integerConstant (0, Type::tsize_t);
+  irs->expandDecl (t_index);
+
+  unsigned unroll = arrayop_unroll (telem);
+  if (unroll > 1)
+    {
+      tree t_unroll = irs->integerConstant (unroll, Type::tsize_t);
+
+      irs->startLoop (NULL);
+      irs->continueHere();
+      irs->exitIfFalse (build2 (GE_EXPR, boolean_type_node,
+				build2 (MINUS_EXPR, t_sizetype, t_len, t_index),
+				t_unroll));
+      for (unsigned k = 0; k < unroll; k++)
+	{
+	  tree t_k = build2 (PLUS_EXPR, t_sizetype, t_index,
+			     irs->integerConstant (k, Type::tsize_t));
+	  irs->doExp (build_arrayop_elem (irs, ce, tokens, ntokens, ptrs, vals, t_k));
+	}
+      irs->doExp (irs->vmodify (t_index, build2 (PLUS_EXPR, t_sizetype,
+						 t_index, t_unroll)));
+      irs->endLoop();
+    }
+
+  // The remaining elements.
+  irs->startLoop (NULL);
+  irs->continueHere();
+  irs->exitIfFalse (build2 (LT_EXPR, boolean_type_node, t_index, t_len));
+  irs->doExp (build_arrayop_elem (irs, ce, tokens, ntokens, ptrs, vals, t_index));
+  irs->doExp (irs->vmodify (t_index, build2 (PLUS_EXPR, t_sizetype, t_index,
+					     irs->integerConstant (1, Type::tsize_t))));
+  irs->endLoop();
+
+  irs->endBindings();
+  tree t_body = irs->popStatementList();
+
+  tree t_type = ce->type->toCtype();
+  if (TYPE_MAIN_VARIANT (TREE_TYPE (t_result)) != TYPE_MAIN_VARIANT (t_type))
+    t_result = irs->vconvert (t_result, t_type);
+  return irs->compound (t_body, t_result);
+}
+
 elem *
 CallExp::toElem (IRState *irs)
 {
+  if (optimize && !optimize_size)
+    {
+      arrayop_token tokens[MAX_INLINE_ARRAYOP_TOKENS];
+      size_t ntokens = arrayop_tokens (this, tokens);
+      if (ntokens)
+	return build_arrayop (irs, this, tokens, ntokens);
+    }
+
   tree call_exp = irs->call (e1, arguments);
 
   TypeFunction *tf = irs->getFuncType (e1->type->toBasetype());
@@ -2186,6 +3303,24 @@ SymbolExp::toElem (IRState *irs)
   return error_mark_node;
 }
 
+/* Return true if instances of class CD have no pointers for the garbage
+   collector to scan, as for flag 2 of the ClassInfo put out by
+   ClassDeclaration::toObjFile.  */
+
+static bool
+class_noscan_p (ClassDeclaration *cd)
+{
+  for (; cd; cd = cd->baseClass)
+    {
+      for (size_t i = 0; cd->members && i < cd->members->dim; i++)
+	{
+	  if ((*cd->members)[i]->hasPointers())
+	    return false;
+	}
+    }
+  return true;
+}
+
 elem *
 NewExp::toElem (IRState *irs)
 {
@@ -2225,6 +3360,19 @@ NewExp::toElem (IRState *irs)
 				  irs->indirect (new_call, rec_type),
 				  class_decl->toInitializer()->Stree);
 	    }
+	  else if (! class_decl->isCOMclass() && ! optimize_size)
+	    {
+	      // Size and flags are known here, so _d_newclass need not
+	      // get them from the ClassInfo; initialize it in place.
+	      tree args[2] = {
+		  irs->integerConstant (class_decl->structsize, Type::tsize_t),
+		  irs->integerConstant (class_noscan_p (class_decl), Type::tbool)
+	      };
+	      new_call = save_expr (irs->libCall (LIBCALL_NEWCLASSN, 2, args));
+	      setup_exp = build2 (MODIFY_EXPR, rec_type,
+				  irs->indirect (new_call, rec_type),
+				  class_decl->toInitializer()->Stree);
+	    }
 	  else
 	    {
 	      tree arg = irs->addressOf (class_decl->toSymbol()->Stree);
@@ -2295,6 +3443,20 @@ NewExp::toElem (IRState *irs)
 	    {
 	      new_call = irs->call (allocator, newargs);
 	    }
+	  else if (! optimize_size)
+	    {
+	      bool zero_p = struct_type->isZeroInit (loc);
+	      tree args[5] = {
+		  irs->integerConstant (1, Type::tsize_t),
+		  irs->integerConstant (struct_type->size(), Type::tsize_t),
+		  irs->integerConstant (! struct_type->hasPointers(), Type::tbool),
+		  irs->integerConstant (zero_p, Type::tbool),
+		  irs->integerConstant (struct_type->arrayOf()->isShared(), Type::tbool)
+	      };
+	      new_call = irs->libCall (LIBCALL_NEWARRAYN, 5, args);
+	      new_call = irs->darrayPtrRef (new_call);
+	      need_init = ! zero_p;
+	    }
 	  else
 	    {
 	      tree args[2];
@@ -2351,7 +3513,32 @@ NewExp::toElem (IRState *irs)
 	     allocated by this call. */
 	  for (size_t i = 0; i < arguments->dim; i++)
 	    elem_init_type = elem_init_type->toBasetype()->nextOf(); // assert ty == Tarray
-	  if (arguments->dim == 1)
+	  if (arguments->dim == 1 && ! optimize_size
+	      && (elem_init_type->isZeroInit()
+		  || elem_init_type->toBasetype()->ty != Tsarray))
+	    {
+	      // Element size and flags are known here, so _d_newarrayT need
+	      // not get them from the TypeInfo; initialize it in place.
+	      bool zero_p = elem_init_type->isZeroInit();
+	      tree args[5] = {
+		  (arguments->tdata()[0])->toElem (irs),
+		  irs->integerConstant (elem_init_type->size(), Type::tsize_t),
+		  irs->integerConstant (! elem_init_type->hasPointers(), Type::tbool),
+		  irs->integerConstant (zero_p, Type::tbool),
+		  irs->integerConstant (type->isShared(), Type::tbool)
+	      };
+	      result = irs->libCall (LIBCALL_NEWARRAYN, 5, args, type->toCtype());
+	      if (! zero_p)
+		{
+		  result = irs->maybeMakeTemp (result);
+		  tree init = irs->convertForAssignment (elem_init_type->defaultInit (loc),
+							 elem_init_type);
+		  result = irs->compound (array_set_expr (irs, irs->darrayPtrRef (result),
+							  init, irs->darrayLenRef (result)),
+					  result);
+		}
+	    }
+	  else if (arguments->dim == 1)
 	    {
 	      lib_call = elem_init_type->isZeroInit() ?
 		LIBCALL_NEWARRAYT : LIBCALL_NEWARRAYIT;
@@ -3324,6 +4511,9 @@ Module::genobjfile (int multiobj)
       genmoduleinfo();
     }
 
+  if (gen.inlineImports)
+    g.ofile->outputImportedFuncs();
+
   g.ofile->endModule();
 }
 
@@ -4283,6 +5473,10 @@ SynchronizedStatement::toIR (IRState *irs)
       TREE_PRIVATE (critsec_decl) = 1;
       DECL_ARTIFICIAL (critsec_decl) = 1;
       DECL_IGNORED_P (critsec_decl) = 1;
+      // The runtime takes the zero initializer as a ready critical section,
+      // and updates the words in it atomically, so they must be aligned.
+      DECL_ALIGN (critsec_decl) = TYPE_ALIGN (ptr_type_node);
+      DECL_USER_ALIGN (critsec_decl) = 1;
 
       rest_of_decl_compilation (critsec_decl, 1, 0);
 
@@ -4405,6 +5599,217 @@ CaseStatement::toIR (IRState *irs)
     }
 }
 
+/* Switches on strings with at most this many cases are expanded inline
+   instead of calling _d_switch_string and friends.  */
+#define MAX_INLINE_STRING_CASES 256
+
+/* Return the code unit at POS in the string of case CASE_STMT.  */
+
+static dinteger_t
+string_case_unit (CaseStatement *case_stmt, size_t pos)
+{
+  StringExp *se = (StringExp *) case_stmt->exp;
+  switch (se->sz)
+    {
+    case 1:
+      return ((unsigned char *) se->string)[pos];
+
+    case 2:
+      return ((d_wchar *) se->string)[pos];
+
+    case 4:
+      return ((d_dchar *) se->string)[pos];
+
+    default:
+      gcc_unreachable();
+    }
+}
+
+/* Return true if the string switch STMT can be expanded inline by
+   build_string_switch.  ELEM_TYPE is the character type of the
+   switch condition.  */
+
+static bool
+inline_string_switch_p (SwitchStatement *stmt, Type *elem_type)
+{
+  if (optimize_size || stmt->hasVars)
+    return false;
+
+  if (!stmt->cases || stmt->cases->dim > MAX_INLINE_STRING_CASES)
+    return false;
+
+  for (size_t i = 0; i < stmt->cases->dim; i++)
+    {
+      Expression *e = stmt->cases->tdata()[i]->exp;
+      if (e->op != TOKstring
+	  || ((StringExp *) e)->sz != elem_type->size())
+	return false;
+    }
+  return true;
+}
+
+/* Emit the dispatch for the cases GROUP[0 .. NGROUP] of string switch
+   STMT, all of which have length LEN.  The strings are told apart
+   by switching on their characters, picking at each level the position
+   that splits the remaining cases the most, until one case is left.
+   That case is then compared in full with memcmp, and T_INDEX is set to
+   its index on a match.  Every path ends with a jump to T_DONE, including
+   a character that matches no case.  */
+
+static void
+build_string_trie (IRState *irs, SwitchStatement *stmt, size_t *group,
+		   size_t ngroup, size_t len, tree t_ptr, tree t_index,
+		   tree t_done, Type *elem_type)
+{
+  CaseStatements *cases = stmt->cases;
+
+  if (ngroup == 1)
+    {
+      CaseStatement *case_stmt = cases->tdata()[group[0]];
+      tree t_set = irs->vmodify (t_index,
+				 irs->integerConstant (case_stmt->index, Type::tint32));
+      if (len == 0)
+	irs->doExp (t_set);
+      else
+	{
+	  StringExp *se = (StringExp *) case_stmt->exp;
+	  tree t_str = build_string (len * se->sz,
+				     gen.hostToTargetString ((char *) se->string, len, se->sz));
+	  TREE_CONSTANT (t_str) = 1;
+	  TREE_READONLY (t_str) = 1;
+	  TREE_TYPE (t_str) = irs->arrayType (elem_type, len);
+
+	  tree t_memcmp = irs->buildCall (d_built_in_decls (BUILT_IN_MEMCMP), 3,
+					  t_ptr, irs->addressOf (t_str),
+					  irs->integerConstant (len * se->sz, Type::tsize_t));
+	  irs->startCond (stmt, irs->boolOp (EQ_EXPR, t_memcmp, integer_zero_node));
+	  irs->doExp (t_set);
+	  irs->endCond();
+	}
+      irs->doJump (NULL, t_done);
+      return;
+    }
+
+  // Find the position with the most distinct characters.
+  size_t best_pos = 0;
+  size_t best_count = 0;
+  dinteger_t *units = (dinteger_t *) alloca (ngroup * sizeof (dinteger_t));
+
+  for (size_t pos = 0; pos < len && best_count < ngroup; pos++)
+    {
+      size_t count = 0;
+      for (size_t i = 0; i < ngroup; i++)
+	{
+	  dinteger_t c = string_case_unit (cases->tdata()[group[i]], pos);
+	  size_t j;
+	  for (j = 0; j < count; j++)
+	    {
+	      if (units[j] == c)
+		break;
+	    }
+	  if (j == count)
+	    units[count++] = c;
+	}
+      if (count > best_count)
+	{
+	  best_pos = pos;
+	  best_count = count;
+	}
+    }
+  gcc_assert (best_count > 1);
+
+  // Order the group by the character at best_pos, keeping equal
+  // characters together.
+  for (size_t i = 1; i < ngroup; i++)
+    {
+      size_t k = group[i];
+      dinteger_t c = string_case_unit (cases->tdata()[k], best_pos);
+      size_t j = i;
+      for (; j > 0 && string_case_unit (cases->tdata()[group[j - 1]], best_pos) > c; j--)
+	group[j] = group[j - 1];
+      group[j] = k;
+    }
+
+  tree t_elemtype = elem_type->toCtype();
+  irs->pushStatementList();
+  for (size_t i = 0; i < ngroup; )
+    {
+      dinteger_t c = string_case_unit (cases->tdata()[group[i]], best_pos);
+      size_t j = i + 1;
+      while (j < ngroup && string_case_unit (cases->tdata()[group[j]], best_pos) == c)
+	j++;
+
+      irs->addExp (build_case_label (irs->integerConstant (c, t_elemtype), NULL_TREE,
+				     irs->label (stmt->loc)));
+      build_string_trie (irs, stmt, group + i, j - i, len, t_ptr,
+			 t_index, t_done, elem_type);
+      i = j;
+    }
+  tree t_body = irs->popStatementList();
+
+  tree t_offset = irs->integerConstant (best_pos * elem_type->size(), Type::tsize_t);
+  tree t_char = irs->indirect (irs->pointerOffset (t_ptr, t_offset), t_elemtype);
+  irs->addExp (build3 (SWITCH_EXPR, t_elemtype, t_char, t_body, NULL_TREE));
+  // No case has the character at BEST_POS.
+  irs->doJump (NULL, t_done);
+}
+
+/* Expand string switch STMT on T_COND inline, as a switch on the length
+   followed by a switch on the characters of the string that tell the
+   cases of that length apart, and a final memcmp.  Returns the index of
+   the matching case, or -1, which is what _d_switch_string returns.
+   STMT->cases must already be sorted and indexed.  */
+
+static tree
+build_string_switch (IRState *irs, SwitchStatement *stmt, tree t_cond,
+		     Type *elem_type)
+{
+  CaseStatements *cases = stmt->cases;
+  tree t_index = irs->localVar (Type::tint32);
+  tree t_done = irs->label (stmt->loc);
+
+  DECL_INITIAL (t_index) = irs->integerConstant (-1, Type::tint32);
+  irs->expandDecl (t_index);
+
+  irs->startBindings();
+  tree t_str = irs->localVar (TREE_TYPE (t_cond));
+  tree t_len = irs->localVar (Type::tsize_t);
+  tree t_ptr = irs->localVar (elem_type->pointerTo());
+
+  DECL_INITIAL (t_str) = t_cond;
+  irs->expandDecl (t_str);
+  DECL_INITIAL (t_len) = irs->darrayLenRef (t_str);
+  irs->expandDecl (t_len);
+  DECL_INITIAL (t_ptr) = irs->darrayPtrRef (t_str);
+  irs->expandDecl (t_ptr);
+
+  size_t *group = (size_t *) alloca (cases->dim * sizeof (size_t));
+  for (size_t i = 0; i < cases->dim; i++)
+    group[i] = i;
+
+  // The cases are sorted on length first, so each length is a run.
+  irs->pushStatementList();
+  for (size_t i = 0; i < cases->dim; )
+    {
+      size_t len = ((StringExp *) cases->tdata()[i]->exp)->len;
+      size_t j = i + 1;
+      while (j < cases->dim && ((StringExp *) cases->tdata()[j]->exp)->len == len)
+	j++;
+
+      irs->addExp (build_case_label (irs->integerConstant (len, Type::tsize_t), NULL_TREE,
+				     irs->label (stmt->loc)));
+      build_string_trie (irs, stmt, group + i, j - i, len, t_ptr,
+			 t_index, t_done, elem_type);
+      i = j;
+    }
+  tree t_body = irs->popStatementList();
+  irs->addExp (build3 (SWITCH_EXPR, TREE_TYPE (t_len), t_len, t_body, NULL_TREE));
+  irs->doLabel (t_done);
+  irs->endBindings();
+
+  return t_index;
+}
+
 void
 SwitchStatement::toIR (IRState *irs)
 {
@@ -4443,25 +5848,35 @@ SwitchStatement::toIR (IRState *irs)
       // have to change them to be useable
       cases->sort(); // %%!!
 
-      Symbol *s = static_sym();
-      dt_t **  pdt = &s->Sdt;
-      s->Sseg = CDATA;
-      for (size_t case_i = 0; case_i < cases->dim; case_i++)
+      if (inline_string_switch_p (this, elem_type))
 	{
-	  CaseStatement *case_stmt = cases->tdata()[case_i];
-	  pdt = case_stmt->exp->toDt (pdt);
-	  case_stmt->index = case_i;
+	  for (size_t case_i = 0; case_i < cases->dim; case_i++)
+	    cases->tdata()[case_i]->index = case_i;
+
+	  cond_tree = build_string_switch (irs, this, cond_tree, elem_type);
 	}
-      outdata (s);
-      tree p_table = irs->addressOf (s->Stree);
+      else
+	{
+	  Symbol *s = static_sym();
+	  dt_t **  pdt = &s->Sdt;
+	  s->Sseg = CDATA;
+	  for (size_t case_i = 0; case_i < cases->dim; case_i++)
+	    {
+	      CaseStatement *case_stmt = cases->tdata()[case_i];
+	      pdt = case_stmt->exp->toDt (pdt);
+	      case_stmt->index = case_i;
+	    }
+	  outdata (s);
+	  tree p_table = irs->addressOf (s->Stree);
 
-      tree args[2] = {
-	  irs->darrayVal (cond_type->arrayOf()->toCtype(),
-			  cases->dim, p_table),
-	  cond_tree
-      };
+	  tree args[2] = {
+	      irs->darrayVal (cond_type->arrayOf()->toCtype(),
+			      cases->dim, p_table),
+	      cond_tree
+	  };
 
-      cond_tree = irs->libCall (lib_call, 2, args);
+	  cond_tree = irs->libCall (lib_call, 2, args);
+	}
     }
   else if (! cond_type->isscalar())
     {
@@ -4567,7 +5982,10 @@ ForStatement::toIR (IRState *irs)
     }
   if (body)
     {
+      bool bounds_fact = irs->pushBoundsFact (this);
       body->toIR (irs);
+      if (bounds_fact)
+	irs->popBoundsFact();
     }
   irs->continueHere();
   if (increment)
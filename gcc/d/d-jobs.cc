@@ -0,0 +1,362 @@
+// d-jobs.cc -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+// Code generation in worker processes, -fcodegen-jobs=N.
+//
+// The modules on the command line are parsed and analyzed once.  Then each
+// of them but the main module is given to a worker forked from that state,
+// which generates the code of the module and runs the backend on it, into
+// an object file of its own.  The compiler itself does the main module into
+// its usual output file, and waits for the workers before it finishes.
+//
+// The worker for dir/name.d writes name.o in the directory of the main
+// object file, or name.s when only compiling to assembly.  The assembler is
+// run through the compiler driver, found from the COLLECT_GCC and
+// COLLECT_GCC_OPTIONS it sets.  When cc1d is run without the driver, the
+// assembly is left in name.s next to the output file.
+//
+// Template instances are put in the main module during semantic analysis,
+// so they are emitted in its object file only, as with -fonly=.
+
+#include "d-gcc-includes.h"
+#include "d-lang.h"
+#include "d-codegen.h"
+
+#include "module.h"
+
+#if defined (HAVE_WORKING_FORK) && ! defined (_WIN32)
+#define D_CODEGEN_JOBS 1
+#endif
+
+#ifdef D_CODEGEN_JOBS
+
+// A module given to a worker.
+struct CodegenJob
+{
+  pid_t pid;
+  Module *module;
+};
+
+static ArrayBase<CodegenJob> codegen_jobs;
+
+// In a worker, whether it is one.
+static bool codegen_worker;
+
+// In a worker run from the driver, the driver and its options for the
+// assembler, and the assembly file to assemble into the object file.
+static const char *codegen_driver;
+static Strings codegen_as_options;
+static char *codegen_asm_file;
+static char *codegen_object_file;
+
+/* Split the value of COLLECT_GCC_OPTIONS, each option quoted as 'opt',
+   into OPTS.  */
+
+static void
+codegen_driver_options (Strings *opts)
+{
+  const char *p = getenv ("COLLECT_GCC_OPTIONS");
+  if (! p)
+    return;
+
+  while (*p)
+    {
+      OutBuffer buf;
+      while (*p == ' ')
+	p++;
+      if (! *p)
+	break;
+
+      while (*p && *p != ' ')
+	{
+	  if (*p == '\'')
+	    {
+	      for (p++; *p && *p != '\''; p++)
+		buf.writeByte (*p);
+	      if (*p)
+		p++;
+	    }
+	  else if (*p == '\\' && p[1])
+	    {
+	      buf.writeByte (p[1]);
+	      p += 2;
+	    }
+	  else
+	    buf.writeByte (*p++);
+	}
+      buf.writeByte (0);
+      opts->push ((char *) buf.extractData());
+    }
+}
+
+/* Assemble the output of the worker on exit, after the backend has
+   finished writing it.  */
+
+static void
+codegen_assemble (void)
+{
+  bool failed = false;
+
+  if (! seen_error ())
+    {
+      Strings argv;
+      argv.push ((char *) codegen_driver);
+      argv.append (&codegen_as_options);
+      argv.push ((char *) "-c");
+      argv.push ((char *) "-x");
+      argv.push ((char *) "assembler");
+      argv.push (codegen_asm_file);
+      argv.push ((char *) "-o");
+      argv.push (codegen_object_file);
+      argv.push (NULL);
+
+      int status, err;
+      const char *errmsg = pex_one (PEX_SEARCH, codegen_driver,
+				    (char * const *) argv.tdata(), progname,
+				    NULL, NULL, &status, &err);
+      if (errmsg)
+	{
+	  fprintf (stderr, "%s: %s: %s\n", progname, errmsg, xstrerror (err));
+	  failed = true;
+	}
+      else if (! WIFEXITED (status) || WEXITSTATUS (status) != 0)
+	failed = true;
+    }
+
+  unlink (codegen_asm_file);
+  if (failed)
+    _exit (FATAL_EXIT_CODE);
+}
+
+/* Set up the worker forked to generate the code of M into OUTPUT, through
+   a temporary assembly file if ASSEMBLE.  */
+
+static void
+codegen_worker_start (Module *m, char *output, bool assemble)
+{
+  // The other workers belong to the compiler.
+  codegen_jobs.setDim (0);
+  codegen_worker = true;
+
+  main_input_filename = m->srcfile->toChars();
+  if (assemble)
+    {
+      codegen_asm_file = make_temp_file (".s");
+      codegen_object_file = output;
+      asm_file_name = codegen_asm_file;
+      atexit (codegen_assemble);
+    }
+  else
+    asm_file_name = output;
+
+  // Redo what the backend did for the output file, for this module.
+  asm_out_file = freopen (asm_file_name, "w+b", asm_out_file);
+  if (! asm_out_file)
+    fatal_error ("can%'t open %s for writing: %m", asm_file_name);
+  targetm.asm_out.file_start ();
+  (*debug_hooks->init) (main_input_filename);
+  (*debug_hooks->start_source_file) (input_line, main_input_filename);
+}
+
+/* Wait for any worker to finish, blocking if HANG, and report its failure.
+   Returns false if none did and not HANG.  */
+
+static bool
+codegen_wait (bool hang)
+{
+  while (codegen_jobs.dim)
+    {
+      int status = 0;
+      pid_t pid = waitpid (-1, &status, hang ? 0 : WNOHANG);
+
+      if (pid < 0 && errno == EINTR)
+	continue;
+      if (pid <= 0)
+	return false;
+
+      for (size_t i = 0; i < codegen_jobs.dim; i++)
+	{
+	  CodegenJob *job = codegen_jobs[i];
+
+	  if (job->pid != pid)
+	    continue;
+
+	  // A worker that exits with an error has already said why.
+	  if (WIFSIGNALED (status))
+	    ::error ("code generation for %s killed by signal %d",
+		     job->module->srcfile->toChars(), WTERMSIG (status));
+	  else if (! WIFEXITED (status) || WEXITSTATUS (status) != 0)
+	    errorcount++;
+
+	  codegen_jobs.remove (i);
+	  delete job;
+	  return true;
+	}
+    }
+  return false;
+}
+
+#endif /* D_CODEGEN_JOBS */
+
+/* Give each module on the command line but MAIN_MODULE to a worker, running
+   at most JOBS of them at once.  Returns the module this process generates
+   code for: MAIN_MODULE in the compiler, or the one given to a worker.
+   Returns NULL if the modules can't be split up, and all of them are to be
+   generated into the output file as usual.  */
+
+Module *
+d_codegen_jobs (Module *main_module, unsigned jobs)
+{
+#ifdef D_CODEGEN_JOBS
+  // What can't be redone by the workers.
+  if (! asm_file_name || ! strcmp (asm_file_name, "-")
+      || profile_arc_flag || flag_test_coverage || flag_stack_usage)
+    return NULL;
+
+  // Where the driver writes the output, and whether it goes on to link.
+  const char *output = asm_file_name;
+  const char *ext = "s";
+  bool assemble = false;
+
+  codegen_driver = getenv ("COLLECT_GCC");
+  if (codegen_driver)
+    {
+      Strings opts;
+      bool compile_only = false;
+
+      codegen_driver_options (&opts);
+      assemble = true;
+      output = NULL;
+      for (size_t i = 0; i < opts.dim; i++)
+	{
+	  char *opt = opts[i];
+	  if (! strcmp (opt, "-o") && i + 1 < opts.dim)
+	    output = opts[++i];
+	  else if (! strcmp (opt, "-c"))
+	    compile_only = true;
+	  else if (! strcmp (opt, "-S"))
+	    {
+	      compile_only = true;
+	      assemble = false;
+	    }
+	  else if (! strncmp (opt, "-m", 2) || ! strncmp (opt, "-B", 2)
+		   || ! strncmp (opt, "-Wa,", 4))
+	    codegen_as_options.push (opt);
+	}
+
+      if (! compile_only)
+	{
+	  warning (0, "-fcodegen-jobs= needs -c or -S, "
+		   "generating all modules into one object file");
+	  return NULL;
+	}
+      if (assemble)
+	ext = "o";
+    }
+
+  const char *dir = output ? FileName::path (output) : NULL;
+
+  // Name the output of each worker.
+  Modules roots;
+  Strings outputs;
+  for (size_t i = 0; i < Module::amodules.dim; i++)
+    {
+      Module *m = Module::amodules[i];
+      if (m->importedFrom != m || m->isDocFile || m == main_module)
+	continue;
+
+      char *name = FileName::name (m->srcfile->toChars());
+      name = FileName::forceExt (name, ext)->toChars();
+      name = FileName::combine (dir, name);
+
+      for (size_t j = 0; j < outputs.dim; j++)
+	{
+	  if (FileName::equals (outputs[j], name))
+	    {
+	      ::error ("modules %s and %s would both be written to %s",
+		       roots[j]->toChars(), m->toChars(), name);
+	      return main_module;
+	    }
+	}
+      if (output && FileName::equals (output, name))
+	{
+	  ::error ("module %s would be written to the output file %s",
+		   m->toChars(), name);
+	  return main_module;
+	}
+      roots.push (m);
+      outputs.push (name);
+    }
+
+  fflush (stdout);
+  fflush (stderr);
+  fflush (asm_out_file);
+
+  for (size_t i = 0; i < roots.dim; i++)
+    {
+      while (codegen_jobs.dim >= jobs)
+	{
+	  if (! codegen_wait (false))
+	    codegen_wait (true);
+	}
+
+      pid_t pid = fork ();
+      if (pid == 0)
+	{
+	  codegen_worker_start (roots[i], outputs[i], assemble);
+	  return roots[i];
+	}
+      if (pid < 0)
+	{
+	  ::error ("cannot start a worker for %s: %m", roots[i]->toChars());
+	  break;
+	}
+
+      CodegenJob *job = new CodegenJob;
+      job->pid = pid;
+      job->module = roots[i];
+      codegen_jobs.push (job);
+    }
+  return main_module;
+#else
+  warning (0, "-fcodegen-jobs= is not supported on this host");
+  return NULL;
+#endif
+}
+
+/* In the compiler, wait for all the workers to finish.  */
+
+void
+d_codegen_jobs_wait (void)
+{
+#ifdef D_CODEGEN_JOBS
+  while (codegen_jobs.dim)
+    codegen_wait (true);
+#endif
+}
+
+/* Return true if this is a worker forked by d_codegen_jobs.  */
+
+bool
+d_codegen_worker_p (void)
+{
+#ifdef D_CODEGEN_JOBS
+  return codegen_worker;
+#else
+  return false;
+#endif
+}
@@ -35,8 +35,11 @@
 #include "module.h"
 #include "cond.h"
 #include "mars.h"
+#include "template.h"
 
 #include "async.h"
+#include "impcache.h"
+#include "ctfeprof.h"
 #include "json.h"
 
 static char lang_name[6] = "GNU D";
@@ -95,6 +98,13 @@ static char lang_name[6] = "GNU D";
 
 
 static const char *fonly_arg;
+static unsigned parse_threads;
+static unsigned codegen_jobs;
+static const char *import_cache_file;
+static const char *ctfe_profile_file;
+static const char *time_report_file;
+static const char *template_repo_file;
+static const char *compile_server_socket;
 
 /* Common initialization before calling option handlers.  */
 static void
@@ -110,6 +120,8 @@ d_init_options (unsigned int, struct cl_decoded_option *decoded_options)
   global.params.useArrayBounds = 2;
   global.params.useSwitchError = 1;
   global.params.useInline = 0;
+  global.params.inlineLimit = 250;
+  global.params.inlineApplyLimit = 500;
   global.params.warnings = 0;
   global.params.obj = 1;
   global.params.Dversion = 2;
@@ -127,6 +139,9 @@ d_init_options (unsigned int, struct cl_decoded_option *decoded_options)
   gen.splitDynArrayVarArgs = false;
   gen.emitTemplates = TEnormal;
   gen.useBuiltins = true;
+  gen.inlineAA = false;
+  gen.inlineImports = false;
+  gen.reportBoundsChecks = false;
   gen.stdInc = true;
 }
 
@@ -365,10 +380,19 @@ d_handle_option (size_t scode, const char *arg, int value,
       global.params.noboundscheck = ! value;
       break;
 
+    case OPT_fbounds_check_report:
+      gen.reportBoundsChecks = value;
+      break;
+
     case OPT_fbuiltin:
       gen.useBuiltins = value;
       break;
 
+    case OPT_fctfe_profile_:
+      ctfe_profile_file = xstrdup (arg);
+      CtfeProfile::enabled = 1;
+      break;
+
     case OPT_fdebug:
       global.params.debuglevel = value ? 1 : 0;
       break;
@@ -393,6 +417,14 @@ d_handle_option (size_t scode, const char *arg, int value,
       strcpy (lang_name, value ? "GNU C" : "GNU D");
       break;
 
+    case OPT_fcodegen_jobs_:
+      codegen_jobs = value;
+      break;
+
+    case OPT_fcompile_server_:
+      compile_server_socket = xstrdup (arg);
+      break;
+
     case OPT_fdeprecated:
       global.params.useDeprecated = value;
       break;
@@ -434,6 +466,10 @@ d_handle_option (size_t scode, const char *arg, int value,
       global.params.vtls = value;
       break;
 
+    case OPT_fd_time_report_:
+      time_report_file = xstrdup (arg);
+      break;
+
     case OPT_femit_templates:
       gen.emitTemplates = value ? TEauto : TEnone;
       break;
@@ -455,14 +491,38 @@ d_handle_option (size_t scode, const char *arg, int value,
 	error ("bad argument for -femit-templates");
       break;
 
+    case OPT_ffrontend_inline:
+      global.params.useInline = value;
+      break;
+
+    case OPT_ffrontend_inline_apply_limit_:
+      global.params.inlineApplyLimit = value;
+      break;
+
+    case OPT_ffrontend_inline_limit_:
+      global.params.inlineLimit = value;
+      break;
+
     case OPT_fignore_unknown_pragmas:
       global.params.ignoreUnsupportedPragmas = value;
       break;
 
+    case OPT_fimport_cache_:
+      import_cache_file = xstrdup (arg);
+      break;
+
     case OPT_fin:
       global.params.useIn = value;
       break;
 
+    case OPT_finline_aa:
+      gen.inlineAA = value;
+      break;
+
+    case OPT_finline_imports:
+      gen.inlineImports = value;
+      break;
+
     case OPT_fintfc:
       global.params.doHdrGeneration = value;
       break;
@@ -505,6 +565,10 @@ d_handle_option (size_t scode, const char *arg, int value,
       global.params.useOut = value;
       break;
 
+    case OPT_fparse_threads_:
+      parse_threads = value;
+      break;
+
     case OPT_fproperty:
       global.params.enforcePropertySyntax = value;
       break;
@@ -524,6 +588,10 @@ d_handle_option (size_t scode, const char *arg, int value,
       gen.splitDynArrayVarArgs = value;
       break;
 
+    case OPT_ftemplate_repository_:
+      template_repo_file = xstrdup (arg);
+      break;
+
     case OPT_funittest:
       global.params.useUnitTests = value;
       break;
@@ -589,6 +657,39 @@ d_handle_option (size_t scode, const char *arg, int value,
   return result;
 }
 
+/* Return true if option CODE names a file the compilation writes besides
+   its object file.  */
+
+bool
+d_output_file_option_p (size_t code)
+{
+  switch (code)
+    {
+    case OPT_fctfe_profile_:
+    case OPT_fdeps_:
+    case OPT_fdoc_file_:
+    case OPT_fd_time_report_:
+    case OPT_fintfc_file_:
+    case OPT_fmake_deps_:
+    case OPT_fmake_mdeps_:
+    case OPT_fXf_:
+      return true;
+
+    default:
+      return false;
+    }
+}
+
+/* Handle the output file option CODE again with the file name ARG, for a
+   compilation done by a child of the compile server.  */
+
+void
+d_handle_output_file_option (size_t code, const char *arg)
+{
+  gcc_assert (d_output_file_option_p (code));
+  d_handle_option (code, arg, 1, 0, UNKNOWN_LOCATION, NULL);
+}
+
 bool
 d_post_options (const char ** fn)
 {
@@ -640,6 +741,10 @@ d_write_global_declarations (void)
   if (! global.errors && ! errorcount)
     finalize_compilation_unit();
 
+  /* The workers generating the other modules with -fcodegen-jobs have
+     been running alongside.  */
+  d_codegen_jobs_wait();
+
   /* After cgraph has had a chance to emit everything that's going to
      be emitted, output debug information for globals.  */
   emit_debug_global_declarations (vec, globalDeclarations.dim);
@@ -774,6 +879,229 @@ deps_write (Module *m)
 
 Symbol *rtlsym[N_RTLSYM];
 
+/* State shared by the jobs parsing the root modules with -fparse-threads.
+   Each job reports into its own MessageSink, so the messages can be shown
+   in command line order afterwards, and a fatal error only stops the job.
+   The allocation counters are kept per thread, so each job hands back what
+   it counted to the main thread.  */
+
+struct ParseJobs
+{
+  Modules *modules;
+  AsyncRead *aw;
+  MessageSink *sinks;
+  bool *readfail;
+  unsigned long long *bytes;
+  unsigned long long *exps;
+  int unique_base;		// Lexer::uniqueNum before the jobs
+  size_t generate_base;		// Identifier::generateNum before the jobs
+  bool *idsfull;
+};
+
+/* The identifiers made up while parsing a module, such as _staticCtorN,
+   are numbered from a range of its own, so their names don't depend on
+   the order the jobs run in.  */
+#define D_PARSE_ID_RANGE 0x10000
+
+static void
+d_parse_job (void *arg, size_t i)
+{
+  ParseJobs *jobs = (ParseJobs *) arg;
+  Module *m = (*jobs->modules)[i];
+  unsigned long long bytes = Mem::allocated;
+  unsigned long long exps = CtfeProfile::numExpressions;
+  int unique_base = jobs->unique_base + i * D_PARSE_ID_RANGE;
+  size_t generate_base = jobs->generate_base + i * D_PARSE_ID_RANGE;
+  jmp_buf stop;
+
+  Lexer::uniqueNum = unique_base;
+  Identifier::generateNum = generate_base;
+
+  MessageSink::setCurrent (&jobs->sinks[i]);
+  jobs->sinks[i].stop = &stop;
+  if (setjmp (stop) == 0)
+    {
+      if (jobs->aw->read (i))
+	jobs->readfail[i] = true;
+      else
+	m->parseSource();
+    }
+  jobs->sinks[i].stop = NULL;
+  MessageSink::setCurrent (NULL);
+
+  jobs->idsfull[i] = (Lexer::uniqueNum - unique_base >= D_PARSE_ID_RANGE
+		      || (Identifier::generateNum - generate_base
+			  >= D_PARSE_ID_RANGE));
+
+  // Added back on the main thread once all jobs are done.
+  jobs->bytes[i] = Mem::allocated - bytes;
+  jobs->exps[i] = CtfeProfile::numExpressions - exps;
+  Mem::allocated = bytes;
+  CtfeProfile::numExpressions = exps;
+}
+
+/* Wall time and memory spent in each phase of d_parse_file, in total
+   and per root module.  Printed with -ftime-report, and written as JSON
+   with -fd-time-report=, when the compiler exits.  Phases are not yet
+   separate GCC timevars, as that needs new entries in timevar.def; to
+   -ftime-report all of d_parse_file is the "parser (global)" timevar
+   pushed by toplev.  */
+
+enum d_phase
+{
+  D_PHASE_PARSE,
+  D_PHASE_IMPORTALL,
+  D_PHASE_SEMANTIC,
+  D_PHASE_SEMANTIC2,
+  D_PHASE_SEMANTIC3,
+  D_PHASE_JSON,
+  D_PHASE_CODEGEN,
+  D_PHASE_MAX
+};
+
+static const char *d_phase_names[D_PHASE_MAX] =
+{
+  "parse", "importall", "semantic", "semantic2", "semantic3", "json", "codegen"
+};
+
+struct d_phase_stats
+{
+  double wall;
+  unsigned long long bytes;
+  double start_wall;
+  unsigned long long start_bytes;
+};
+
+static d_phase_stats d_phases[D_PHASE_MAX];
+
+// The phase being timed, or D_PHASE_MAX.
+static d_phase d_phase_current = D_PHASE_MAX;
+
+// The modules with times in Module::phaseTimes, in the order timed.
+static Modules d_timed_modules;
+
+static double
+d_wall_time (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+d_phase_begin (d_phase phase)
+{
+  d_phases[phase].start_wall = d_wall_time ();
+  d_phases[phase].start_bytes = Mem::allocated;
+  d_phase_current = phase;
+}
+
+static void
+d_phase_end (d_phase phase)
+{
+  d_phases[phase].wall += d_wall_time () - d_phases[phase].start_wall;
+  d_phases[phase].bytes += Mem::allocated - d_phases[phase].start_bytes;
+  d_phase_current = D_PHASE_MAX;
+}
+
+/* Add the time since START to the time spent on module M in PHASE.  */
+
+static void
+d_module_time (Module *m, d_phase phase, double start)
+{
+  if (! m->phaseTimes)
+    {
+      m->phaseTimes = XCNEWVEC (double, D_PHASE_MAX);
+      d_timed_modules.push (m);
+    }
+  m->phaseTimes[phase] += d_wall_time () - start;
+}
+
+/* Print the phase times for -ftime-report, and write them along with the
+   per module times and frontend counters to FILENAME if not NULL.  */
+
+static void
+d_time_report (const char *filename)
+{
+  double total = 0;
+  unsigned long long total_bytes = 0;
+
+  for (int i = 0; i < D_PHASE_MAX; i++)
+    {
+      total += d_phases[i].wall;
+      total_bytes += d_phases[i].bytes;
+    }
+
+  if (time_report)
+    {
+      fprintf (stderr, "\nD frontend phases:\n");
+      for (int i = 0; i < D_PHASE_MAX; i++)
+	{
+	  fprintf (stderr, " %-22s: %7.2f (%2.0f%%) wall %10llu kB\n",
+		   d_phase_names[i], d_phases[i].wall,
+		   total ? d_phases[i].wall * 100 / total : 0,
+		   d_phases[i].bytes / 1024);
+	}
+      fprintf (stderr, " %-22s: %7.2f        wall %10llu kB\n",
+	       "TOTAL", total, total_bytes / 1024);
+      fprintf (stderr, " template instances %u, CTFE calls %lu, "
+	       "deferred semantic passes %u, modules %u\n",
+	       TemplateStats::numInstances, CtfeProfile::numCalls,
+	       Module::deferredPasses, (unsigned) Module::amodules.dim);
+    }
+
+  if (!filename)
+    return;
+
+  OutBuffer buf;
+  buf.printf ("{\n  \"version\": \"%s\",\n", global.version);
+  buf.writestring ("  \"phases\": {\n");
+  for (int i = 0; i < D_PHASE_MAX; i++)
+    {
+      buf.printf ("    \"%s\": { \"wall\": %.6f, \"bytes\": %llu }%s\n",
+		  d_phase_names[i], d_phases[i].wall, d_phases[i].bytes,
+		  i + 1 < D_PHASE_MAX ? "," : "");
+    }
+  buf.writestring ("  },\n  \"modules\": [\n");
+  for (size_t i = 0; i < d_timed_modules.dim; i++)
+    {
+      Module *m = d_timed_modules[i];
+      buf.printf ("    { \"name\": \"%s\"", m->toChars());
+      for (int j = 0; j < D_PHASE_MAX; j++)
+	buf.printf (", \"%s\": %.6f", d_phase_names[j], m->phaseTimes[j]);
+      buf.printf (" }%s\n", i + 1 < d_timed_modules.dim ? "," : "");
+    }
+  buf.writestring ("  ],\n  \"counters\": {\n");
+  buf.printf ("    \"wall\": %.6f,\n", total);
+  buf.printf ("    \"bytes_allocated\": %llu,\n", Mem::allocated);
+  buf.printf ("    \"modules\": %u,\n", (unsigned) Module::amodules.dim);
+  buf.printf ("    \"template_instances\": %u,\n", TemplateStats::numInstances);
+  buf.printf ("    \"ctfe_calls\": %lu,\n", CtfeProfile::numCalls);
+  buf.printf ("    \"deferred_semantic_passes\": %u\n", Module::deferredPasses);
+  buf.writestring ("  }\n}\n");
+
+  File f ((char *) filename);
+  f.setbuffer ((void *) buf.data, buf.offset);
+  f.ref = 1;
+  f.writev();
+}
+
+/* Report the phase times when the compiler exits, so they come after
+   GCC's own -ftime-report, and are also given when compiling failed.  */
+
+static void
+d_time_report_atexit (void)
+{
+  if (d_codegen_worker_p ())
+    return;
+
+  // Left open by an error.
+  if (d_phase_current != D_PHASE_MAX)
+    d_phase_end (d_phase_current);
+
+  d_time_report (time_report_file);
+}
+
 void
 d_parse_file (void)
 {
@@ -795,6 +1123,19 @@ d_parse_file (void)
   global.params.obj = ! flag_syntax_only;
   global.params.pic = flag_pic != 0; // Has no effect yet.
 
+  if (import_cache_file)
+    ImportCache::load (import_cache_file);
+
+  if (compile_server_socket)
+    d_compile_server (compile_server_socket, &fonly_arg);
+
+  // Registered once the compile server, if any, does the compilation.
+  if (time_report || time_report_file)
+    atexit (d_time_report_atexit);
+
+  if (template_repo_file && ! flag_syntax_only)
+    TemplateRepository::load (template_repo_file);
+
   // better to use input_location.xxx ?
   (*debug_hooks->start_source_file) (input_line, main_input_filename);
 
@@ -814,6 +1155,9 @@ d_parse_file (void)
   modules.reserve (num_in_fnames);
   AsyncRead *aw = NULL;
   Module *m = NULL;
+  Module *output_module = NULL;
+  ParseJobs jobs;
+  jobs.sinks = NULL;
 
   // %% FIX
   if (! main_input_filename)
@@ -894,6 +1238,7 @@ d_parse_file (void)
   gcc_assert (an_output_module);
 
   // Read files
+  d_phase_begin (D_PHASE_PARSE);
   aw = AsyncRead::create (modules.dim);
   for (size_t i = 0; i < modules.dim; i++)
     {
@@ -902,21 +1247,74 @@ d_parse_file (void)
     }
   aw->start();
 
+  if (parse_threads > 1)
+    {
+      // Lex and parse in parallel, modules are declared in order below.
+      jobs.modules = &modules;
+      jobs.aw = aw;
+      jobs.sinks = new MessageSink[modules.dim];
+      jobs.readfail = new bool[modules.dim];
+      jobs.bytes = new unsigned long long[modules.dim];
+      jobs.exps = new unsigned long long[modules.dim];
+      jobs.unique_base = Lexer::uniqueNum;
+      jobs.generate_base = Identifier::generateNum;
+      jobs.idsfull = new bool[modules.dim];
+      for (size_t i = 0; i < modules.dim; i++)
+	{
+	  m = modules[i];
+	  if (!Module::rootModule)
+	    Module::rootModule = m;
+	  m->importedFrom = m;
+	  jobs.readfail[i] = false;
+	}
+      AsyncJobs::run (parse_threads, modules.dim, &d_parse_job, &jobs);
+      for (size_t i = 0; i < modules.dim; i++)
+	{
+	  Mem::allocated += jobs.bytes[i];
+	  CtfeProfile::numExpressions += jobs.exps[i];
+	  gcc_assert (! jobs.idsfull[i]);
+	}
+      // Carry on numbering after the ranges of the jobs.
+      Lexer::uniqueNum = jobs.unique_base + modules.dim * D_PARSE_ID_RANGE;
+      Identifier::generateNum = (jobs.generate_base
+				 + modules.dim * D_PARSE_ID_RANGE);
+    }
+
   // Parse files
   for (size_t i = 0; i < modules.dim; i++)
     {
       m = modules[i];
+      double start = d_wall_time ();
       if (global.params.verbose)
 	fprintf (stdmsg, "parse     %s\n", m->toChars());
-      if (!Module::rootModule)
-	Module::rootModule = m;
-      m->importedFrom = m;
-      if (aw->read (i))
+      if (jobs.sinks)
 	{
-	  error ("cannot read file %s", m->srcfile->name->toChars());
-	  goto had_errors;
+	  // Doc files are removed from modules as they are found, so
+	  // offset by the number removed so far to get the job index.
+	  size_t j = i + (num_in_fnames - modules.dim);
+	  jobs.sinks[j].flush();
+	  if (jobs.sinks[j].stopped)
+	    fatal();
+	  if (jobs.readfail[j])
+	    {
+	      error ("cannot read file %s", m->srcfile->name->toChars());
+	      goto had_errors;
+	    }
+	  if (!m->isDocFile)
+	    m->declareModule();
+	}
+      else
+	{
+	  if (!Module::rootModule)
+	    Module::rootModule = m;
+	  m->importedFrom = m;
+	  if (aw->read (i))
+	    {
+	      error ("cannot read file %s", m->srcfile->name->toChars());
+	      goto had_errors;
+	    }
+	  m->parse();
 	}
-      m->parse();
       d_gcc_magic_module (m);
       if (m->isDocFile)
 	{
@@ -925,8 +1323,11 @@ d_parse_file (void)
 	  modules.remove (i);
 	  i--;
 	}
+      else
+	d_module_time (m, D_PHASE_PARSE, start);
     }
   AsyncRead::dispose (aw);
+  d_phase_end (D_PHASE_PARSE);
 
   if (global.errors)
     goto had_errors;
@@ -953,24 +1354,31 @@ d_parse_file (void)
     goto had_errors;
 
   // load all unconditional imports for better symbol resolving
+  d_phase_begin (D_PHASE_IMPORTALL);
   for (size_t i = 0; i < modules.dim; i++)
     {
       m = modules[i];
+      double start = d_wall_time ();
       if (global.params.verbose)
 	fprintf (stdmsg, "importall %s\n", m->toChars());
       m->importAll (0);
+      d_module_time (m, D_PHASE_IMPORTALL, start);
     }
+  d_phase_end (D_PHASE_IMPORTALL);
 
   if (global.errors)
     goto had_errors;
 
   // Do semantic analysis
+  d_phase_begin (D_PHASE_SEMANTIC);
   for (size_t i = 0; i < modules.dim; i++)
     {
       m = modules[i];
+      double start = d_wall_time ();
       if (global.params.verbose)
 	fprintf (stdmsg, "semantic  %s\n", m->toChars());
       m->semantic();
+      d_module_time (m, D_PHASE_SEMANTIC, start);
     }
 
   if (global.errors)
@@ -978,28 +1386,89 @@ d_parse_file (void)
 
   Module::dprogress = 1;
   Module::runDeferredSemantic();
+  d_phase_end (D_PHASE_SEMANTIC);
 
   // Do pass 2 semantic analysis
+  d_phase_begin (D_PHASE_SEMANTIC2);
   for (size_t i = 0; i < modules.dim; i++)
     {
       m = modules[i];
+      double start = d_wall_time ();
       if (global.params.verbose)
 	fprintf (stdmsg, "semantic2 %s\n", m->toChars());
       m->semantic2();
+      d_module_time (m, D_PHASE_SEMANTIC2, start);
     }
+  d_phase_end (D_PHASE_SEMANTIC2);
 
   if (global.errors)
     goto had_errors;
 
   // Do pass 3 semantic analysis
+  d_phase_begin (D_PHASE_SEMANTIC3);
   for (size_t i = 0; i < modules.dim; i++)
     {
       m = modules[i];
+      double start = d_wall_time ();
       if (global.params.verbose)
 	fprintf (stdmsg, "semantic3 %s\n", m->toChars());
       m->semantic3();
+      d_module_time (m, D_PHASE_SEMANTIC3, start);
+    }
+  d_phase_end (D_PHASE_SEMANTIC3);
+
+  if (! optimize)
+    gen.inlineImports = false;
+  if (flag_syntax_only)
+    {
+      gen.inlineImports = false;
+      global.params.useInline = 0;
+    }
+
+  // Bodies of imported functions are only analyzed to be inlined.
+  if ((gen.inlineImports || global.params.useInline) && ! global.errors)
+    {
+      d_phase_begin (D_PHASE_SEMANTIC3);
+      for (size_t i = 0; i < Module::amodules.dim; i++)
+	{
+	  m = Module::amodules[i];
+	  if (m->importedFrom == m)
+	    continue;
+	  if (global.params.verbose)
+	    fprintf (stdmsg, "semantic3 %s\n", m->toChars());
+	  m->semantic3();
+	}
+      d_phase_end (D_PHASE_SEMANTIC3);
+    }
+
+  // Do inline expansion in the frontend, with -ffrontend-inline.
+  if (global.params.useInline && ! global.errors)
+    {
+      for (size_t i = 0; i < modules.dim; i++)
+	{
+	  m = modules[i];
+	  if (global.params.verbose)
+	    fprintf (stdmsg, "inline scan %s\n", m->toChars());
+	  m->inlineScan();
+	}
     }
 
+  if (compile_server_socket)
+    d_compile_server_report();
+
+  if (global.params.verbose)
+    {
+      TemplateStats::print();
+      ImportCache::printStats();
+      CtfeProfile::printStats();
+    }
+
+  if (import_cache_file)
+    ImportCache::save (import_cache_file);
+
+  if (ctfe_profile_file)
+    CtfeProfile::write (ctfe_profile_file);
+
   if (global.errors)
     goto had_errors;
 
@@ -1037,22 +1506,34 @@ d_parse_file (void)
   if (global.errors || global.warnings)
     goto had_errors;
 
+  // Generate output files
+  if (global.params.doXGeneration)
+    {
+      d_phase_begin (D_PHASE_JSON);
+      json_generate (&modules);
+      d_phase_end (D_PHASE_JSON);
+    }
+
+  // With -fcodegen-jobs, the other modules are generated by workers,
+  // each returning here to generate its own.
+  output_module = fonly_arg ? an_output_module : NULL;
+  if (codegen_jobs && ! fonly_arg && ! flag_syntax_only && ! template_repo_file)
+    output_module = d_codegen_jobs (an_output_module, codegen_jobs);
+
   g.ofile = new ObjectFile();
-  if (fonly_arg)
-    g.ofile->modules.push (an_output_module);
+  if (output_module)
+    g.ofile->modules.push (output_module);
   else
     g.ofile->modules.append (&modules);
   g.irs = & gen; // needed for FuncDeclaration::toObjFile
 
-  // Generate output files
-  if (global.params.doXGeneration)
-    json_generate (&modules);
-
+  d_phase_begin (D_PHASE_CODEGEN);
   for (size_t i = 0; i < modules.dim; i++)
     {
       m = modules[i];
-      if (fonly_arg && m != an_output_module)
+      if (output_module && m != output_module)
 	continue;
+      double start = d_wall_time ();
       if (global.params.verbose)
 	fprintf (stdmsg, "code      %s\n", m->toChars());
       if (! flag_syntax_only)
@@ -1062,7 +1543,12 @@ d_parse_file (void)
 	  if (global.params.doDocComments)
 	    m->gendocfile();
 	}
+      d_module_time (m, D_PHASE_CODEGEN, start);
     }
+  d_phase_end (D_PHASE_CODEGEN);
+
+  if (template_repo_file && ! flag_syntax_only && ! errorcount)
+    TemplateRepository::save();
 
   // better to use input_location.xxx ?
   (*debug_hooks->end_source_file) (input_line);
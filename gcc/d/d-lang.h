@@ -90,6 +90,10 @@ extern GTY(()) tree d_eh_personality_decl;
 /* True if the symbol is an in/out contract.  */
 #define D_DECL_IS_CONTRACT(NODE) (DECL_LANG_FLAG_4 (FUNCTION_DECL_CHECK (NODE)))
 
+/* True if the template instance is emitted by another object file, as
+   recorded in the template repository.  */
+#define D_DECL_REPO_EXTERN(NODE) (DECL_LANG_FLAG_5 (NODE))
+
 /* The D front-end does not use the 'binding level' system for a symbol table,
    It is only needed to get debugging information for local variables and
    otherwise support the backend. */
@@ -194,6 +198,15 @@ extern const char *multilib_dir;
 void add_import_paths (bool stdinc);
 void add_phobos_versyms (void);
 
+/* In d-server.cc */
+void d_compile_server (const char *socket_name, const char **fonly_arg);
+void d_compile_server_report (void);
+
+/* In d-jobs.cc */
+Module *d_codegen_jobs (Module *main_module, unsigned jobs);
+void d_codegen_jobs_wait (void);
+bool d_codegen_worker_p (void);
+
 #endif
 
 #ifdef __cplusplus
@@ -223,6 +236,9 @@ void insert_block (tree);
 void set_block (tree);
 tree getdecls (void);
 
+bool d_output_file_option_p (size_t code);
+void d_handle_output_file_option (size_t code, const char *arg);
+
 /* In d-builtins.c */
 extern const struct attribute_spec d_common_attribute_table[];
 extern const struct attribute_spec d_common_format_attribute_table[];
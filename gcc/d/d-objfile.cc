@@ -32,6 +32,7 @@ unsigned  ObjectFile::moduleSearchIndex;
 DeferredThunks ObjectFile::deferredThunks;
 FuncDeclarations ObjectFile::staticCtorList;
 FuncDeclarations ObjectFile::staticDtorList;
+FuncDeclarations ObjectFile::importedFuncs;
 
 ObjectFile::ObjectFile (void)
 {
@@ -279,6 +280,7 @@ ObjectFile::setupSymbolStorage (Dsymbol *dsym, tree decl_tree, bool force_static
       bool is_template = false;
       Dsymbol *sym = dsym->toParent();
       Module *ti_obj_file_mod;
+      Module *ti_src_mod;
 
       while (sym)
 	{
@@ -286,6 +288,7 @@ ObjectFile::setupSymbolStorage (Dsymbol *dsym, tree decl_tree, bool force_static
 	  if (ti)
 	    {
 	      ti_obj_file_mod = ti->objFileModule;
+	      ti_src_mod = ti->tempdecl ? ti->tempdecl->getModule() : NULL;
 	      is_template = true;
 	      break;
 	    }
@@ -299,6 +302,16 @@ ObjectFile::setupSymbolStorage (Dsymbol *dsym, tree decl_tree, bool force_static
 	  D_DECL_ONE_ONLY (decl_tree) = 1;
 	  D_DECL_IS_TEMPLATE (decl_tree) = 1;
 	  is_static = hasModule (ti_obj_file_mod) && gen.emitTemplates != TEnone;
+
+	  // Leave it to the object file that the template repository says
+	  // emits it.  Nested functions are private to their parent.
+	  if (is_static && gen.emitTemplates != TEprivate
+	      && (! func_decl || ! func_decl->isNested())
+	      && ! TemplateRepository::shouldEmit (decl_tree, ti_src_mod))
+	    {
+	      D_DECL_REPO_EXTERN (decl_tree) = 1;
+	      is_static = false;
+	    }
 	}
       else
 	is_static = hasModule (dsym->getModule());
@@ -414,6 +427,35 @@ ObjectFile::outputFunction (FuncDeclaration *f)
     }
 }
 
+/* Give the backend the bodies of the functions from other object files
+   referenced so far that are small enough to inline.  They stay external,
+   like extern inline functions in GNU C, so the backend doesn't emit
+   them, and calls that aren't inlined go to the other object file.  */
+
+void
+ObjectFile::outputImportedFuncs (void)
+{
+  // Emitting a body may reference more of them.
+  for (size_t i = 0; i < importedFuncs.dim; i++)
+    {
+      FuncDeclaration *fd = importedFuncs[i];
+      tree decl = fd->toSymbol()->Stree;
+
+      if (! DECL_EXTERNAL (decl) || D_DECL_IS_TEMPLATE (decl)
+	  || DECL_UNINLINABLE (decl) || fd->isMain()
+	  || fd->isStaticCtorDeclaration() || fd->isStaticDtorDeclaration()
+	  || fd->isUnitTestDeclaration() || fd->isInvariantDeclaration()
+	  || ! fd->canInlineImport())
+	continue;
+
+      TREE_STATIC (decl) = 1;
+      DECL_DECLARED_INLINE_P (decl) = 1;
+      DECL_NO_INLINE_WARNING_P (decl) = 1;
+      fd->toObjFile (false);
+    }
+  importedFuncs.setDim (0);
+}
+
 /* Multiple copies of the same template instantiations can
    be passed to the backend from the frontend leaving
    assembler errors left in their wrath.
@@ -485,6 +527,10 @@ ObjectFile::shouldEmit (Symbol *sym)
 	return false;
     }
 
+  // Emitted by another object file.
+  if (D_DECL_REPO_EXTERN (sym->Stree))
+    return false;
+
   // Not emitting templates, so return true all others.
   if (gen.emitTemplates == TEnone)
     return ! D_DECL_IS_TEMPLATE (sym->Stree);
@@ -87,6 +87,11 @@ struct ObjectFile
   static void outputStaticSymbol (Symbol *s);
   static void outputFunction (FuncDeclaration *f);
 
+  // Functions from other object files referenced here, whose bodies
+  // may be given to the backend to inline with -finline-imports.
+  static FuncDeclarations importedFuncs;
+  static void outputImportedFuncs (void);
+
   static void addAggMethod (tree rec_type, FuncDeclaration *fd);
 
   static void initTypeDecl (tree t, Dsymbol *d_sym);
@@ -135,5 +140,15 @@ struct ObjectFile
 
 };
 
+// Record of which compilation emits each template instance, shared
+// between compilations, see d-repo.cc.
+struct TemplateRepository
+{
+  static void load (const char *filename);
+  static void save (void);
+
+  static bool shouldEmit (tree decl_tree, Module *src_mod);
+};
+
 #endif
 
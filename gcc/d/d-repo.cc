@@ -0,0 +1,425 @@
+// d-repo.cc -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+// The template instantiation repository, -ftemplate-repository=FILE.
+//
+// Without it, every object file emits all the template instances it uses
+// and the linker throws away the duplicate COMDAT copies.  With it, FILE
+// records which compilation emits each instance, keyed by mangled name,
+// and other compilations only declare the instance.  Each line is
+//	mangled-name source-hash owner
+// where the owner is the primary source file of the compilation, and the
+// source hash is that of the module declaring the template, so a changed
+// template is emitted again by the next compilation that uses it.
+//
+// The file is read at the start of the compilation, and merged back at the
+// end with the entries of compilations that finished in between.  Both are
+// done holding a lock on the file.
+//
+// An instance can still go missing at link time, when its owner stops using
+// it or is left out of the link.  So each compilation also writes a .rpo
+// file next to its object file, in the format collect2 reads for the C++
+// -frepo option, listing the instances it emits and those it relies on.
+// When the link fails on an undefined instance, collect2 marks it as chosen
+// in the .rpo file of an object that uses it and recompiles that source,
+// which then emits the instance whatever the repository says.
+
+#include "d-gcc-includes.h"
+#include "d-lang.h"
+#include "d-codegen.h"
+
+#include "module.h"
+
+struct RepoEntry
+{
+  hash_t srchash;
+  const char *owner;
+  bool claimed;		// emitted by this compilation
+  bool external;	// relied on here, emitted by another compilation
+  bool chosen;		// to be emitted here, as chosen by collect2
+};
+
+static const char *repo_file;
+static const char *repo_owner;
+static const char *repo_rpo_file;
+static StringTable *repo_table;
+static Strings repo_names;
+
+/* Lock FD for reading or writing, waiting for other compilations.  */
+
+static void
+repo_lock (int fd, bool write_p)
+{
+#ifdef F_SETLKW
+  struct flock fl;
+  memset (&fl, 0, sizeof (fl));
+  fl.l_type = write_p ? F_WRLCK : F_RDLCK;
+  fl.l_whence = SEEK_SET;
+  while (fcntl (fd, F_SETLKW, &fl) == -1 && errno == EINTR)
+    continue;
+#endif
+}
+
+/* Read all of FD into a newly allocated, nul terminated buffer.  */
+
+static char *
+repo_read (int fd)
+{
+  size_t len = 0, alloc = 4096;
+  char *buf = XNEWVEC (char, alloc);
+  ssize_t n;
+
+  while ((n = read (fd, buf + len, alloc - len - 1)) != 0)
+    {
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  break;
+	}
+      len += n;
+      if (alloc - len == 1)
+	{
+	  alloc *= 2;
+	  buf = XRESIZEVEC (char, buf, alloc);
+	}
+    }
+  buf[len] = 0;
+  return buf;
+}
+
+/* Call FN for each well formed line of the repository text BUF.  */
+
+static void
+repo_parse (char *buf, void (*fn) (const char *, hash_t, const char *))
+{
+  char *p = buf;
+  while (*p)
+    {
+      char *line = p;
+      char *eol = strchr (p, '\n');
+      if (! eol)
+	break;
+      *eol = 0;
+      p = eol + 1;
+
+      char *mangle = line;
+      char *q = strchr (line, ' ');
+      if (! q)
+	continue;
+      *q++ = 0;
+      char *end;
+      unsigned long long srchash = strtoull (q, &end, 16);
+      if (end == q || *end != ' ' || ! end[1])
+	continue;
+      fn (mangle, (hash_t) srchash, end + 1);
+    }
+}
+
+static RepoEntry *
+repo_lookup (const char *mangle)
+{
+  StringValue *sv = repo_table->lookup (mangle, strlen (mangle));
+  return sv ? (RepoEntry *) sv->ptrvalue : NULL;
+}
+
+static RepoEntry *
+repo_insert (const char *mangle)
+{
+  size_t len = strlen (mangle);
+  StringValue *sv = repo_table->update (mangle, len);
+  if (! sv->ptrvalue)
+    {
+      RepoEntry *e = new RepoEntry;
+      e->srchash = 0;
+      e->owner = NULL;
+      e->claimed = false;
+      e->external = false;
+      e->chosen = false;
+      sv->ptrvalue = e;
+      repo_names.push (sv->lstring.toDchars());
+    }
+  return (RepoEntry *) sv->ptrvalue;
+}
+
+/* Enter an entry read at the start of the compilation.  */
+
+static void
+repo_load_entry (const char *mangle, hash_t srchash, const char *owner)
+{
+  RepoEntry *e = repo_insert (mangle);
+  e->srchash = srchash;
+  e->owner = xstrdup (owner);
+}
+
+/* Merge an entry of the repository as it is at the end of the compilation.
+   Instances this compilation no longer emits are dropped, the others are
+   kept unless this compilation replaced a stale one.  */
+
+static void
+repo_merge_entry (const char *mangle, hash_t srchash, const char *owner)
+{
+  if (! strcmp (owner, repo_owner))
+    return;
+
+  RepoEntry *e = repo_insert (mangle);
+  if (e->claimed && e->srchash != srchash)
+    return;
+
+  e->srchash = srchash;
+  e->owner = xstrdup (owner);
+  e->claimed = false;
+}
+
+/* Return the next argument of the COLLECT_GCC_OPTIONS string at *PP,
+   where each is quoted as 'arg', and a quote in it is written '\''.  */
+
+static char *
+repo_extract_string (const char **pp)
+{
+  const char *p = *pp;
+  OutBuffer buf;
+
+  while (*p == ' ')
+    p++;
+  while (*p && *p != ' ')
+    {
+      if (*p == '\'')
+	{
+	  p++;
+	  while (*p && *p != '\'')
+	    buf.writeByte (*p++);
+	  if (*p)
+	    p++;
+	}
+      else if (*p == '\\' && p[1])
+	{
+	  buf.writeByte (p[1]);
+	  p += 2;
+	}
+      else
+	buf.writeByte (*p++);
+    }
+  *pp = p;
+  buf.writeByte (0);
+  return (char *) buf.extractData();
+}
+
+/* Return the name of the .rpo file of this compilation, made from the
+   object file name as collect2 does, or NULL if there is no object file
+   for the link to find it by.  */
+
+static const char *
+repo_rpo_name (void)
+{
+  const char *p = getenv ("COLLECT_GCC_OPTIONS");
+  const char *output = NULL;
+  bool compiling = false;
+
+  while (p && *p)
+    {
+      char *q = repo_extract_string (&p);
+      if (! strcmp (q, "-o"))
+	output = repo_extract_string (&p);
+      else if (! strcmp (q, "-c"))
+	compiling = true;
+    }
+
+  const char *base;
+  if (compiling && output)
+    base = output;
+  else if (p && ! compiling)
+    return NULL;
+  else
+    base = lbasename (main_input_filename);
+
+  // Replace the extension of the file name, if any.
+  const char *ext = strrchr (lbasename (base), '.');
+  size_t len = ext ? (size_t) (ext - base) : strlen (base);
+  return concat (xstrndup (base, len), ".rpo", NULL);
+}
+
+/* Read the .rpo file left by a previous compilation of this source, for
+   the instances collect2 chose it to emit to resolve the link.  */
+
+static void
+repo_read_rpo (const char *filename)
+{
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  char *buf = repo_read (fd);
+  close (fd);
+
+  char *p = buf;
+  while (*p)
+    {
+      char *line = p;
+      char *eol = strchr (p, '\n');
+      if (! eol)
+	break;
+      *eol = 0;
+      p = eol + 1;
+
+      if (line[0] == 'C' && line[1] == ' ')
+	repo_insert (line + 2)->chosen = true;
+    }
+  free (buf);
+}
+
+/* Write the .rpo file FILENAME for collect2.  It holds the main source,
+   the directory and the options to compile it again, then a 'C' line for
+   each instance emitted here and an 'O' line for each instance used here
+   but emitted elsewhere.  */
+
+static void
+repo_write_rpo (const char *filename)
+{
+  FILE *f = fopen (filename, "w");
+  if (! f)
+    {
+      warning (0, "cannot write repository information file %s: %m",
+	       filename);
+      return;
+    }
+
+  const char *args = getenv ("COLLECT_GCC_OPTIONS");
+  fprintf (f, "M %s\n", main_input_filename);
+  fprintf (f, "D %s\n", getpwd ());
+  if (args)
+    fprintf (f, "A %s\n", args);
+
+  for (size_t i = 0; i < repo_names.dim; i++)
+    {
+      RepoEntry *e = repo_lookup (repo_names[i]);
+      if (e->claimed)
+	fprintf (f, "C %s\n", repo_names[i]);
+      else if (e->external)
+	fprintf (f, "O %s\n", repo_names[i]);
+    }
+
+  if (fclose (f) != 0)
+    warning (0, "cannot write repository information file %s: %m",
+	     filename);
+}
+
+void
+TemplateRepository::load (const char *filename)
+{
+  repo_rpo_file = repo_rpo_name ();
+  if (! repo_rpo_file)
+    {
+      // Without an object file to keep, nothing could recover an
+      // instance that goes missing, so everything is emitted here.
+      warning (0, "-ftemplate-repository must be used with -c");
+      return;
+    }
+
+  repo_file = filename;
+  repo_owner = main_input_filename;
+  repo_table = new StringTable;
+  repo_table->init (1009);
+  repo_read_rpo (repo_rpo_file);
+
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  repo_lock (fd, false);
+  char *buf = repo_read (fd);
+  close (fd);
+
+  repo_parse (buf, repo_load_entry);
+  free (buf);
+}
+
+/* Return true if the template instance DECL_TREE, declared in module
+   SRC_MOD, is to be emitted by this compilation; otherwise another
+   compilation emits it.  */
+
+bool
+TemplateRepository::shouldEmit (tree decl_tree, Module *src_mod)
+{
+  if (! repo_table || ! src_mod || ! DECL_ASSEMBLER_NAME_SET_P (decl_tree))
+    return true;
+
+  const char *mangle = IDENTIFIER_POINTER (DECL_ASSEMBLER_NAME (decl_tree));
+  RepoEntry *e = repo_lookup (mangle);
+
+  if (e && ! e->claimed && ! e->chosen && e->owner
+      && e->srchash == src_mod->srchash && strcmp (e->owner, repo_owner))
+    {
+      e->external = true;
+      return false;
+    }
+
+  e = repo_insert (mangle);
+  e->srchash = src_mod->srchash;
+  e->owner = repo_owner;
+  e->claimed = true;
+
+  // Other object files are going to link against it, so the backend
+  // must not drop it when all uses here are inlined.
+  DECL_PRESERVE_P (decl_tree) = 1;
+  return true;
+}
+
+void
+TemplateRepository::save (void)
+{
+  if (! repo_table || global.errors)
+    return;
+
+  int fd = open (repo_file, O_RDWR | O_CREAT, 0666);
+  if (fd < 0)
+    {
+      warning (0, "cannot open template repository %s: %m", repo_file);
+      return;
+    }
+
+  repo_lock (fd, true);
+  char *buf = repo_read (fd);
+
+  // Entries of others read at the start are taken again from the file,
+  // as their owners may have been compiled since.
+  for (size_t i = 0; i < repo_names.dim; i++)
+    {
+      RepoEntry *e = repo_lookup (repo_names[i]);
+      if (! e->claimed)
+	e->owner = NULL;
+    }
+  repo_parse (buf, repo_merge_entry);
+  free (buf);
+
+  OutBuffer out;
+  for (size_t i = 0; i < repo_names.dim; i++)
+    {
+      RepoEntry *e = repo_lookup (repo_names[i]);
+      if (e->owner)
+	out.printf ("%s %llx %s\n", repo_names[i],
+		    (unsigned long long) e->srchash, e->owner);
+    }
+
+  if (lseek (fd, 0, SEEK_SET) != 0 || ftruncate (fd, 0) != 0
+      || write (fd, out.data, out.offset) != (ssize_t) out.offset)
+    warning (0, "cannot write template repository %s: %m", repo_file);
+
+  close (fd);
+
+  repo_write_rpo (repo_rpo_file);
+}
@@ -0,0 +1,771 @@
+// d-server.cc -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+// The compile server, -fcompile-server=SOCKET.
+//
+// The first compilation to find no server listening on SOCKET forks one
+// off before doing its own work.  The server keeps the modules imported
+// by the compilations it has done, read and parsed, and runs each new
+// compilation in a child process forked from that state, so only the
+// modules it hasn't seen yet are read and parsed.  Semantic analysis is
+// still done by each compilation: the template instances it creates are
+// placed in the root modules, so the analyzed state of an import is
+// particular to the compilation that did it.  It follows that a cached
+// module only depends on its own source, and is stale when the contents
+// of the file change, or when a new file elsewhere on the import path
+// hides it.
+//
+// A compilation is only sent to the server when it has the same working
+// directory and options, besides the names of the input and output files.
+// That includes the files named by options like -fmake-deps=, which are
+// sent along with the request and set again in the child.  Otherwise,
+// or if the server is gone or finds a cached module is stale, the
+// compilation is done in-process as usual.  A server with stale modules
+// stops listening, so the next compilation starts a fresh one.
+
+#include "d-gcc-includes.h"
+#include "d-lang.h"
+#include "d-codegen.h"
+
+#include "module.h"
+#include "impcache.h"
+
+#if defined (HAVE_WORKING_FORK) && ! defined (_WIN32)
+#define D_COMPILE_SERVER 1
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#endif
+
+#ifdef D_COMPILE_SERVER
+
+// Seconds without a compilation after which the server exits.
+#define SERVER_IDLE_TIMEOUT (30 * 60)
+
+// A module read and parsed by the server.
+struct ServerModule
+{
+  Module *module;
+  char *name;		// module name as a path, without extension
+  char *path;		// the file it was read from
+  struct stat st;
+  hash_t hash;		// of the contents of the file
+};
+
+// A compilation running in a child of the server.
+struct ServerJob
+{
+  pid_t pid;
+  int conn;		// connection of the client
+  int report;		// modules imported by the child
+  OutBuffer names;
+};
+
+static ArrayBase<ServerModule> server_modules;
+
+// In a child of the server, where to write the modules it imported.
+static int server_report_fd = -1;
+
+/* Write LEN bytes of BUF to FD.  */
+
+static bool
+server_write (int fd, const void *buf, size_t len)
+{
+  const char *p = (const char *) buf;
+  while (len)
+    {
+      ssize_t n = write (fd, p, len);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return false;
+	}
+      p += n;
+      len -= n;
+    }
+  return true;
+}
+
+/* Append everything that can be read from FD to BUF until end of file.  */
+
+static void
+server_read (int fd, OutBuffer *buf)
+{
+  char tmp[4096];
+  ssize_t n;
+  while ((n = read (fd, tmp, sizeof (tmp))) != 0)
+    {
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  break;
+	}
+      buf->write (tmp, n);
+    }
+}
+
+static bool
+server_address (const char *socket_name, struct sockaddr_un *addr)
+{
+  if (strlen (socket_name) >= sizeof (addr->sun_path))
+    return false;
+
+  memset (addr, 0, sizeof (*addr));
+  addr->sun_family = AF_UNIX;
+  strcpy (addr->sun_path, socket_name);
+  return true;
+}
+
+/* The options that have to match for the server to do a compilation:
+   all of them besides the input and output files.  Options naming other
+   files the compilation writes have to be there, but not the names.  */
+
+static char *
+server_key (void)
+{
+  OutBuffer buf;
+  buf.writestring (version_string);
+  buf.writeByte ('\n');
+  buf.writestring (getpwd ());
+
+  for (unsigned i = 0; i < save_decoded_options_count; i++)
+    {
+      struct cl_decoded_option *opt = &save_decoded_options[i];
+      if (opt->opt_index == OPT_SPECIAL_input_file
+	  || opt->opt_index == OPT_o
+	  || opt->opt_index == OPT_auxbase
+	  || opt->opt_index == OPT_auxbase_strip
+	  || opt->opt_index == OPT_dumpbase
+	  || opt->opt_index == OPT_fonly_)
+	continue;
+      buf.writeByte ('\n');
+      if (d_output_file_option_p (opt->opt_index))
+	buf.writestring (cl_options[opt->opt_index].opt_text);
+      else
+	buf.writestring (opt->orig_option_with_args_text);
+    }
+  buf.writeByte (0);
+  return (char *) buf.extractData();
+}
+
+/* Return how many options name files the compilation writes besides its
+   output file.  As they are part of the key, the server and the
+   compilations it does have as many, in the same order.  */
+
+static size_t
+server_num_output_options (void)
+{
+  size_t n = 0;
+  for (unsigned i = 0; i < save_decoded_options_count; i++)
+    n += d_output_file_option_p (save_decoded_options[i].opt_index);
+  return n;
+}
+
+/* Hash of the contents of the file PATH, or 0 if it can't be read.  */
+
+static hash_t
+server_hash_file (char *path)
+{
+  File f (path);
+  if (f.read())
+    return 0;
+  return String::calcHash ((char *) f.buffer, f.len);
+}
+
+/* Read and parse the module NAME, given as "std.stdio", unless it has been
+   already.  Returns false if that introduced errors.  */
+
+static bool
+server_load (char *name)
+{
+  Identifiers *packages = new Identifiers;
+  Identifier *id;
+  char *p;
+
+  while ((p = strchr (name, '.')))
+    {
+      *p = 0;
+      packages->push (Lexer::idPool (name));
+      name = p + 1;
+    }
+  id = Lexer::idPool (name);
+
+  DsymbolTable *dst = Package::resolve (packages, NULL, NULL);
+  if (dst->lookup (id))
+    return true;
+
+  OutBuffer buf;
+  for (size_t i = 0; i < packages->dim; i++)
+    {
+      buf.writestring ((*packages)[i]->toChars());
+      buf.writeByte ('/');
+    }
+  buf.writestring (id->toChars());
+  buf.writeByte (0);
+  char *filename = (char *) buf.extractData();
+  char *path = Module::findFile (filename);
+  if (! path)
+    return true;
+
+  ServerModule sm;
+  if (stat (path, &sm.st) != 0)
+    return true;
+  sm.hash = server_hash_file (path);
+
+  unsigned errors = global.errors;
+  Module *m = Module::load (0, packages, id);
+  if (! m || global.errors != errors)
+    return false;
+
+  sm.module = m;
+  sm.name = filename;
+  sm.path = path;
+  server_modules.push (new ServerModule (sm));
+  return true;
+}
+
+/* Return false if a cached module changed, or is now hidden by another
+   file along the import path.  The contents are compared, as a file can
+   be changed without its time stamp or size showing it.  */
+
+static bool
+server_fresh_p (void)
+{
+  ImportCache::reset();
+
+  for (size_t i = 0; i < server_modules.dim; i++)
+    {
+      ServerModule *sm = server_modules[i];
+      struct stat st;
+
+      if (stat (sm->path, &st) != 0)
+	return false;
+
+      if (server_hash_file (sm->path) != sm->hash)
+	return false;
+      sm->st = st;
+
+      char *path = Module::findFile (sm->name);
+      if (! path || strcmp (path, sm->path))
+	return false;
+    }
+  return true;
+}
+
+/* In the child doing a compilation, take out of the module tables the
+   cached modules that are compiled as root modules.  */
+
+static void
+server_forget_roots (void)
+{
+  for (unsigned i = 0; i < num_in_fnames; i++)
+    {
+      struct stat st;
+      if (stat (in_fnames[i], &st) != 0)
+	continue;
+
+      for (size_t j = 0; j < server_modules.dim; j++)
+	{
+	  ServerModule *sm = server_modules[j];
+	  if (sm->st.st_dev != st.st_dev || sm->st.st_ino != st.st_ino)
+	    continue;
+
+	  Module *m = sm->module;
+	  Package *pkg = m->parent ? m->parent->isPackage() : NULL;
+	  DsymbolTable *dst = pkg ? pkg->symtab : Module::modules;
+	  dst->remove (m->ident);
+
+	  for (size_t k = 0; k < Module::amodules.dim; k++)
+	    {
+	      if (Module::amodules[k] == m)
+		{
+		  Module::amodules.remove (k);
+		  break;
+		}
+	    }
+	}
+    }
+}
+
+/* Set the environment variable NAME to VAL, or unset it if VAL is empty.  */
+
+static void
+server_setenv (const char *name, const char *val)
+{
+  if (*val)
+    setenv (name, val, 1);
+  else
+    unsetenv (name);
+}
+
+/* Set up the child forked by the server to do the compilation REQ, made of
+   the nul separated strings: key, output file, -fonly= argument, dump and
+   aux base names, COLLECT_GCC and COLLECT_GCC_OPTIONS, the arguments of the
+   output file options, and the input files.  */
+
+static void
+server_child (char *req, size_t len, const char **fonly_arg)
+{
+  char *end = req + len;
+  const char *fields[7];
+
+  for (size_t i = 0; i < 7; i++)
+    {
+      fields[i] = req;
+      req += strlen (req) + 1;
+    }
+
+  asm_file_name = xstrdup (fields[1]);
+  *fonly_arg = *fields[2] ? xstrdup (fields[2]) : NULL;
+  dump_base_name = *fields[3] ? xstrdup (fields[3]) : NULL;
+  aux_base_name = *fields[4] ? xstrdup (fields[4]) : NULL;
+
+  // The driver environment of this compilation, not that of the one that
+  // started the server, is what -ftemplate-repository= records and what
+  // the -fcodegen-jobs= workers are run with.
+  server_setenv ("COLLECT_GCC", fields[5]);
+  server_setenv ("COLLECT_GCC_OPTIONS", fields[6]);
+
+  // Write the other outputs to the files named by this compilation, not
+  // to those of the compilation that started the server.
+  for (unsigned i = 0; i < save_decoded_options_count; i++)
+    {
+      size_t code = save_decoded_options[i].opt_index;
+      if (d_output_file_option_p (code))
+	{
+	  d_handle_output_file_option (code, xstrdup (req));
+	  req += strlen (req) + 1;
+	}
+    }
+
+  Strings *inputs = new Strings;
+  while (req < end)
+    {
+      inputs->push (xstrdup (req));
+      req += strlen (req) + 1;
+    }
+  in_fnames = (const char **) inputs->tdata();
+  num_in_fnames = inputs->dim;
+  main_input_filename = in_fnames[0];
+
+  server_forget_roots();
+
+  // Redo what the backend did for the output file before the
+  // server started, this time for the output of this compilation.
+  asm_out_file = freopen (asm_file_name, "w+b", asm_out_file);
+  if (! asm_out_file)
+    fatal_error ("can%'t open %s for writing: %m", asm_file_name);
+  targetm.asm_out.file_start ();
+  (*debug_hooks->init) (main_input_filename);
+}
+
+/* Run the server listening on LFD.  Returns only in the child processes
+   doing the compilations, set up to do them.  */
+
+static void
+server_run (int lfd, const char *socket_name, const char **fonly_arg)
+{
+  char *key = server_key();
+  size_t noutputs = server_num_output_options();
+  ArrayBase<ServerJob> jobs;
+  bool listening = true;
+
+  signal (SIGPIPE, SIG_IGN);
+
+  while (listening || jobs.dim)
+    {
+      struct pollfd *fds = XNEWVEC (struct pollfd, jobs.dim + 1);
+      size_t nfds = 0;
+
+      for (size_t i = 0; i < jobs.dim; i++)
+	{
+	  fds[nfds].fd = jobs[i]->report;
+	  fds[nfds].events = POLLIN;
+	  nfds++;
+	}
+      if (listening)
+	{
+	  fds[nfds].fd = lfd;
+	  fds[nfds].events = POLLIN;
+	  nfds++;
+	}
+
+      int n = poll (fds, nfds, jobs.dim ? -1 : SERVER_IDLE_TIMEOUT * 1000);
+      if (n <= 0)
+	{
+	  free (fds);
+	  if (n < 0 && errno == EINTR)
+	    continue;
+	  break;
+	}
+
+      // Compilations that finished, reply with their exit status.
+      for (size_t i = jobs.dim; i-- > 0; )
+	{
+	  ServerJob *job = jobs[i];
+	  if (! (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+	    continue;
+
+	  char tmp[4096];
+	  ssize_t len = read (job->report, tmp, sizeof (tmp));
+	  if (len > 0 || (len < 0 && errno == EINTR))
+	    {
+	      if (len > 0)
+		job->names.write (tmp, len);
+	      continue;
+	    }
+
+	  int status;
+	  while (waitpid (job->pid, &status, 0) < 0 && errno == EINTR)
+	    continue;
+	  unsigned char word[4];
+	  for (size_t j = 0; j < 4; j++)
+	    word[j] = (unsigned) status >> (24 - 8 * j);
+	  server_write (job->conn, word, 4);
+	  close (job->conn);
+	  close (job->report);
+
+	  // Parse the modules it imported for the next compilations.
+	  job->names.writeByte (0);
+	  char *p = (char *) job->names.data;
+	  char *eol;
+	  while (listening && (eol = strchr (p, '\n')))
+	    {
+	      *eol = 0;
+	      if (! server_load (p))
+		{
+		  close (lfd);
+		  unlink (socket_name);
+		  listening = false;
+		}
+	      p = eol + 1;
+	    }
+
+	  jobs.remove (i);
+	  delete job;
+	}
+
+      if (! listening || ! (fds[nfds - 1].revents & POLLIN))
+	{
+	  free (fds);
+	  continue;
+	}
+      free (fds);
+
+      int conn = accept (lfd, NULL, NULL);
+      if (conn < 0)
+	continue;
+
+      OutBuffer req;
+      server_read (conn, &req);
+      size_t keylen = strlen (key) + 1;
+      size_t nfields = 0;
+      for (size_t i = 0; i < req.offset; i++)
+	nfields += req.data[i] == 0;
+
+      // The key, six more fields, the output file options and at least
+      // one input file.
+      if (nfields < 8 + noutputs || memcmp (req.data, key, keylen)
+	  || req.data[req.offset - 1] != 0)
+	{
+	  server_write (conn, "D", 1);
+	  close (conn);
+	  continue;
+	}
+
+      if (! server_fresh_p ())
+	{
+	  server_write (conn, "D", 1);
+	  close (conn);
+	  close (lfd);
+	  unlink (socket_name);
+	  listening = false;
+	  continue;
+	}
+
+      int report[2];
+      if (pipe (report) != 0 || ! server_write (conn, "A", 1))
+	{
+	  close (conn);
+	  continue;
+	}
+
+      fflush (stdout);
+      fflush (stderr);
+      pid_t pid = fork ();
+      if (pid == 0)
+	{
+	  close (lfd);
+	  close (report[0]);
+	  for (size_t i = 0; i < jobs.dim; i++)
+	    {
+	      close (jobs[i]->conn);
+	      close (jobs[i]->report);
+	    }
+	  signal (SIGPIPE, SIG_DFL);
+	  dup2 (conn, 1);
+	  dup2 (conn, 2);
+	  close (conn);
+	  server_report_fd = report[1];
+	  server_child ((char *) req.data, req.offset - 1, fonly_arg);
+	  return;
+	}
+
+      close (report[1]);
+      if (pid < 0)
+	{
+	  // The client sees no exit status, and compiles in-process.
+	  close (report[0]);
+	  close (conn);
+	  continue;
+	}
+
+      ServerJob *job = new ServerJob;
+      job->pid = pid;
+      job->conn = conn;
+      job->report = report[0];
+      jobs.push (job);
+    }
+
+  if (listening)
+    unlink (socket_name);
+  _exit (0);
+}
+
+/* Start a server listening on SOCKET_NAME.  Returns in the compilation
+   starting it, and in the children of the server.  */
+
+static void
+server_start (const char *socket_name, const char **fonly_arg)
+{
+  struct sockaddr_un addr;
+  if (! server_address (socket_name, &addr))
+    return;
+
+  int lfd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (lfd < 0)
+    return;
+
+  // Only the user may connect, the server writes files on their behalf.
+  mode_t mask = umask (077);
+  int bound = bind (lfd, (struct sockaddr *) &addr, sizeof (addr));
+  umask (mask);
+  if (bound != 0 || listen (lfd, 64) != 0)
+    {
+      // Most likely another compilation started one first.
+      close (lfd);
+      return;
+    }
+
+  fflush (stdout);
+  fflush (stderr);
+  fflush (asm_out_file);
+  pid_t pid = fork ();
+  if (pid != 0)
+    {
+      close (lfd);
+      if (pid < 0)
+	unlink (socket_name);
+      return;
+    }
+
+  // Detach from the terminal and from the pipes of the compiler driver.
+  setsid ();
+  int null = open ("/dev/null", O_RDWR);
+  if (null >= 0)
+    {
+      dup2 (null, 0);
+      dup2 (null, 1);
+      dup2 (null, 2);
+      if (null > 2)
+	close (null);
+    }
+  asm_out_file = freopen ("/dev/null", "w", asm_out_file);
+
+  server_run (lfd, socket_name, fonly_arg);
+}
+
+/* Send this compilation to the server at SOCKET_NAME.  Returns -1 if no
+   server is listening, 0 if it is not going to do it, otherwise 1 after
+   relaying its output, with its wait status in *STATUS.  */
+
+static int
+server_request (const char *socket_name, const char *fonly_arg, int *status)
+{
+  struct sockaddr_un addr;
+  if (! server_address (socket_name, &addr))
+    return 0;
+
+  int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return 0;
+
+  if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0)
+    {
+      int err = errno;
+      close (fd);
+      if (err == ECONNREFUSED)
+	{
+	  // Left over by a server that didn't exit cleanly.
+	  unlink (socket_name);
+	  return -1;
+	}
+      return err == ENOENT ? -1 : 0;
+    }
+
+  OutBuffer req;
+  char *key = server_key();
+  req.writestring (key);
+  req.writeByte (0);
+  req.writestring (asm_file_name);
+  req.writeByte (0);
+  req.writestring (fonly_arg ? fonly_arg : "");
+  req.writeByte (0);
+  req.writestring (dump_base_name ? dump_base_name : "");
+  req.writeByte (0);
+  req.writestring (aux_base_name ? aux_base_name : "");
+  req.writeByte (0);
+  const char *collect_gcc = getenv ("COLLECT_GCC");
+  req.writestring (collect_gcc ? collect_gcc : "");
+  req.writeByte (0);
+  const char *collect_gcc_options = getenv ("COLLECT_GCC_OPTIONS");
+  req.writestring (collect_gcc_options ? collect_gcc_options : "");
+  req.writeByte (0);
+  for (unsigned i = 0; i < save_decoded_options_count; i++)
+    {
+      struct cl_decoded_option *opt = &save_decoded_options[i];
+      if (d_output_file_option_p (opt->opt_index))
+	{
+	  req.writestring (opt->arg);
+	  req.writeByte (0);
+	}
+    }
+  for (unsigned i = 0; i < num_in_fnames; i++)
+    {
+      req.writestring (in_fnames[i]);
+      req.writeByte (0);
+    }
+  free (key);
+
+  // The server writes the output file from now on.
+  fflush (asm_out_file);
+
+  char reply;
+  if (! server_write (fd, req.data, req.offset)
+      || shutdown (fd, SHUT_WR) != 0
+      || read (fd, &reply, 1) != 1 || reply != 'A')
+    {
+      close (fd);
+      return 0;
+    }
+
+  // Pass on the output of the compilation, but for the last four bytes,
+  // which are its exit status.
+  unsigned char buf[4 + 4096];
+  size_t held = 0;
+  ssize_t n;
+  while ((n = read (fd, buf + held, sizeof (buf) - held)) != 0)
+    {
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  break;
+	}
+      held += n;
+      if (held > 4)
+	{
+	  fwrite (buf, 1, held - 4, stderr);
+	  memmove (buf, buf + held - 4, 4);
+	  held = 4;
+	}
+    }
+  close (fd);
+  fflush (stderr);
+
+  if (held != 4)
+    {
+      warning (0, "compile server at %s failed, compiling in-process",
+	       socket_name);
+      return 0;
+    }
+
+  *status = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+  return 1;
+}
+
+#endif /* D_COMPILE_SERVER */
+
+/* Called at the start of the compilation with -fcompile-server=SOCKET_NAME.
+   If the server at SOCKET_NAME does the compilation, exits with its status.
+   Otherwise returns to do it in-process, which may be in a child of the
+   server, with the input and output files and *FONLY_ARG changed.  */
+
+void
+d_compile_server (const char *socket_name, const char **fonly_arg)
+{
+#ifdef D_COMPILE_SERVER
+  // What can't be redone by the children of the server.
+  if (flag_syntax_only || ! asm_file_name || ! strcmp (asm_file_name, "-")
+      || (global.params.makeDeps && ! global.params.makeDepsFile)
+      || profile_arc_flag || flag_test_coverage || flag_stack_usage)
+    return;
+
+  int status;
+  switch (server_request (socket_name, *fonly_arg, &status))
+    {
+    case 1:
+      if (WIFSIGNALED (status))
+	fatal_error ("compilation in the compile server killed by signal %d",
+		     WTERMSIG (status));
+      exit (WEXITSTATUS (status));
+
+    case -1:
+      server_start (socket_name, fonly_arg);
+      break;
+    }
+#else
+  warning (0, "-fcompile-server= is not supported on this host");
+#endif
+}
+
+/* In a child of the compile server, tell the server which modules were
+   imported, so it can read and parse them for the next compilations.  */
+
+void
+d_compile_server_report (void)
+{
+#ifdef D_COMPILE_SERVER
+  if (server_report_fd < 0)
+    return;
+
+  OutBuffer buf;
+  for (size_t i = 0; i < Module::amodules.dim; i++)
+    {
+      Module *m = Module::amodules[i];
+      if (m->importedFrom == m || m->isDocFile)
+	continue;
+      buf.writestring (m->toPrettyChars());
+      buf.writeByte ('\n');
+    }
+
+  // The file is closed on exit, which tells the server we are done.
+  server_write (server_report_fd, buf.data, buf.offset);
+#endif
+}
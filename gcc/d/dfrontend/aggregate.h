@@ -168,6 +168,9 @@ struct StructDeclaration : AggregateDeclaration
     FuncDeclaration *buildCpCtor(Scope *sc);
 
     FuncDeclaration *buildXopEquals(Scope *sc);
+#ifdef IN_GCC
+    int needFieldEquals();
+#endif
 #endif
     void toDocBuffer(OutBuffer *buf);
 
@@ -90,8 +90,9 @@ void Array::reserve(unsigned nentries)
             memcpy(data, &smallarray[0], dim * sizeof(*data));
         }
         else
-        {   allocdim = dim + nentries;
-            data = (void **)mem.realloc(data, allocdim * sizeof(*data));
+        {   size_t oldsize = allocdim * sizeof(*data);
+            allocdim = dim + nentries;
+            data = (void **)mem.realloc(data, allocdim * sizeof(*data), oldsize);
         }
     }
 }
@@ -117,7 +118,7 @@ void Array::fixDim()
                 mem.free(data);
             }
             else
-                data = (void **)mem.realloc(data, dim * sizeof(*data));
+                data = (void **)mem.realloc(data, dim * sizeof(*data), allocdim * sizeof(*data));
         }
         allocdim = dim;
     }
@@ -13,7 +13,7 @@
 #include <stdlib.h>
 #include <assert.h>
 
-#ifndef IN_GCC
+#if !defined(IN_GCC) || !_WIN32
 
 #if _WIN32
 
@@ -121,7 +121,7 @@ unsigned __stdcall startthread(void *p)
     return EXIT_SUCCESS;                // if skidding
 }
 
-#elif linux  // Posix
+#elif linux || defined(IN_GCC)  // Posix
 
 #include <errno.h>
 #include <pthread.h>
@@ -199,6 +199,7 @@ void AsyncRead::start()
             this);
         if (status != 0)
             err_abort(status, "create thread");
+        pthread_detach(thread_id);
     }
 }
 
@@ -249,7 +250,7 @@ void *startthread(void *p)
     for (size_t i = 0; i < dim; i++)
     {   FileData *f = &aw->files[i];
 
-        f->result = f->file->read();
+        f->result = f->file->mmread();
 
         // Set event
         int status = pthread_mutex_lock(&f->mutex);
@@ -335,3 +336,157 @@ void AsyncRead::dispose(AsyncRead *aw)
 }
 
 #endif
+
+/* ======================== AsyncJobs =============================== */
+
+struct AsyncJobs
+{
+    static void run(unsigned nthreads, size_t njobs,
+                    void (*fn)(void *arg, size_t i), void *arg);
+    static void lock();
+    static void unlock();
+
+    static int running;
+};
+
+int AsyncJobs::running = 0;
+
+#if _WIN32
+
+/* Jobs are simply run in order on the calling thread.
+ */
+
+void AsyncJobs::run(unsigned nthreads, size_t njobs,
+                    void (*fn)(void *arg, size_t i), void *arg)
+{
+    for (size_t i = 0; i < njobs; i++)
+        fn(arg, i);
+}
+
+void AsyncJobs::lock()
+{
+}
+
+void AsyncJobs::unlock()
+{
+}
+
+#else
+
+#include <pthread.h>
+
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void jobs_abort(int status, const char *msg)
+{
+    fprintf(stderr, "fatal error = %d, %s\n", status, msg);
+    exit(EXIT_FAILURE);
+}
+
+struct JobQueue
+{
+    void (*fn)(void *arg, size_t i);
+    void *arg;
+    size_t njobs;
+    size_t next;                // next job to hand out
+
+    pthread_mutex_t mutex;
+};
+
+static void *jobthread(void *p)
+{
+    JobQueue *q = (JobQueue *)p;
+
+    while (1)
+    {
+        int status = pthread_mutex_lock(&q->mutex);
+        if (status != 0)
+            jobs_abort(status, "lock mutex");
+        size_t i = q->next++;
+        status = pthread_mutex_unlock(&q->mutex);
+        if (status != 0)
+            jobs_abort(status, "unlock mutex");
+
+        if (i >= q->njobs)
+            break;
+        q->fn(q->arg, i);
+    }
+    return NULL;                        // end thread
+}
+
+/*******************************
+ * Run fn(arg, i) for i in 0..njobs using up to nthreads threads,
+ * one of which is the calling thread.  Returns once all jobs are done.
+ */
+
+void AsyncJobs::run(unsigned nthreads, size_t njobs,
+                    void (*fn)(void *arg, size_t i), void *arg)
+{
+    if (nthreads > njobs)
+        nthreads = njobs;
+    if (nthreads <= 1)
+    {
+        for (size_t i = 0; i < njobs; i++)
+            fn(arg, i);
+        return;
+    }
+
+    JobQueue q;
+    q.fn = fn;
+    q.arg = arg;
+    q.njobs = njobs;
+    q.next = 0;
+    int status = pthread_mutex_init(&q.mutex, NULL);
+    if (status != 0)
+        jobs_abort(status, "init mutex");
+
+    // The front end recurses deeply, don't rely on the default stack size
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 16 * 1024 * 1024);
+
+    running = 1;
+    pthread_t *threads = (pthread_t *)malloc((nthreads - 1) * sizeof(pthread_t));
+    for (unsigned t = 0; t < nthreads - 1; t++)
+    {
+        status = pthread_create(&threads[t], &attr, &jobthread, &q);
+        if (status != 0)
+            jobs_abort(status, "create thread");
+    }
+
+    jobthread(&q);
+
+    for (unsigned t = 0; t < nthreads - 1; t++)
+    {
+        status = pthread_join(threads[t], NULL);
+        if (status != 0)
+            jobs_abort(status, "join thread");
+    }
+    running = 0;
+
+    free(threads);
+    pthread_attr_destroy(&attr);
+    pthread_mutex_destroy(&q.mutex);
+}
+
+void AsyncJobs::lock()
+{
+    if (running)
+    {
+        int status = pthread_mutex_lock(&jobs_mutex);
+        if (status != 0)
+            jobs_abort(status, "lock mutex");
+    }
+}
+
+void AsyncJobs::unlock()
+{
+    if (running)
+    {
+        int status = pthread_mutex_unlock(&jobs_mutex);
+        if (status != 0)
+            jobs_abort(status, "unlock mutex");
+    }
+}
+
+#endif
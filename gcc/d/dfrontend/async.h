@@ -30,4 +30,23 @@ struct AsyncRead
 };
 
 
+/*******************
+ * Simple interface to run a number of independent jobs
+ * on a pool of threads.
+ */
+
+struct AsyncJobs
+{
+    static void run(unsigned nthreads, size_t njobs,
+                    void (*fn)(void *arg, size_t i), void *arg);
+
+    /* Guard state shared by the jobs, these do nothing
+     * unless jobs are being run in parallel.
+     */
+    static void lock();
+    static void unlock();
+
+    static int running;
+};
+
 #endif
@@ -338,6 +338,61 @@ FuncDeclaration *StructDeclaration::buildOpEquals(Scope *sc)
     return fop;
 }
 
+#ifdef IN_GCC
+/*******************************************
+ * Return !=0 if values of type t are equal exactly when their bytes are.
+ * Fields that overlap are compared by their bytes.
+ */
+
+static int bitwiseEquals(Type *t)
+{
+    t = t->toBasetype();
+    switch (t->ty)
+    {
+        case Tsarray:
+            return bitwiseEquals(t->nextOf());
+
+        case Tstruct:
+        {   StructDeclaration *sd = ((TypeStruct *)t)->sym;
+            unsigned end = 0;
+            for (size_t i = 0; i < sd->fields.dim; i++)
+            {   VarDeclaration *v = sd->fields[i];
+                if (v->offset < end)
+                    return 1;
+                end = v->offset + v->type->size();
+            }
+
+            d_uns64 size = 0;
+            for (size_t i = 0; i < sd->fields.dim; i++)
+            {   VarDeclaration *v = sd->fields[i];
+                if (!bitwiseEquals(v->type))
+                    return 0;
+                size += v->type->size();
+            }
+            return size == sd->structsize;
+        }
+
+        case Tvector:
+            return 1;
+
+        default:
+            return !t->isfloating();
+    }
+}
+
+/*******************************************
+ * == of a struct without opEquals compares it field by field, floating
+ * point fields by value and skipping the padding.  Return !=0 if that
+ * can differ from comparing the bytes, so that TypeInfo_Struct.equals
+ * needs an __xopEquals to agree with ==.
+ */
+
+int StructDeclaration::needFieldEquals()
+{
+    return !bitwiseEquals(type);
+}
+#endif
+
 /******************************************
  * Build __xopEquals for TypeInfo_Struct
  *      bool __xopEquals(in void* p, in void* q) { ... }
@@ -345,12 +400,24 @@ FuncDeclaration *StructDeclaration::buildOpEquals(Scope *sc)
 
 FuncDeclaration *StructDeclaration::buildXopEquals(Scope *sc)
 {
+    int fieldwise = 0;
+
     if (!search_function(this, Id::eq))
+    {
+#ifdef IN_GCC
+        if (!needFieldEquals())
+            return NULL;
+        fieldwise = 1;
+#else
         return NULL;
+#endif
+    }
 
     /* static bool__xopEquals(in void* p, in void* q) {
      *     return ( *cast(const S*)(p) ).opEquals( *cast(const S*)(q) );
      * }
+     * or without opEquals:
+     *     return *cast(const S*)(p) == *cast(const S*)(q);
      */
 
     Parameters *parameters = new Parameters;
@@ -362,13 +429,21 @@ FuncDeclaration *StructDeclaration::buildXopEquals(Scope *sc)
     Identifier *id = Lexer::idPool("__xopEquals");
     FuncDeclaration *fop = new FuncDeclaration(loc, 0, id, STCstatic, tf);
 
-    Expression *e = new CallExp(0,
-        new DotIdExp(0,
+    Expression *e;
+    if (fieldwise)
+        e = new EqualExp(TOKequal, 0,
             new PtrExp(0, new CastExp(0,
                 new IdentifierExp(0, Id::p), type->pointerTo()->constOf())),
-            Id::eq),
-        new PtrExp(0, new CastExp(0,
-            new IdentifierExp(0, Id::q), type->pointerTo()->constOf())));
+            new PtrExp(0, new CastExp(0,
+                new IdentifierExp(0, Id::q), type->pointerTo()->constOf())));
+    else
+        e = new CallExp(0,
+            new DotIdExp(0,
+                new PtrExp(0, new CastExp(0,
+                    new IdentifierExp(0, Id::p), type->pointerTo()->constOf())),
+                Id::eq),
+            new PtrExp(0, new CastExp(0,
+                new IdentifierExp(0, Id::q), type->pointerTo()->constOf())));
 
     fop->fbody = new ReturnStatement(loc, e);
 
@@ -404,7 +479,8 @@ FuncDeclaration *StructDeclaration::buildXopEquals(Scope *sc)
 
             xerreq = fd;
         }
-        fop = xerreq;
+        // TypeInfo_Struct.equals compares the bytes then
+        fop = fieldwise ? NULL : xerreq;
     }
 
     sc->pop();
@@ -0,0 +1,302 @@
+// ctfeprof.c -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#if !_WIN32
+#include <sys/time.h>
+#endif
+
+#include "rmem.h"
+#include "root.h"
+#include "stringtable.h"
+
+#include "mars.h"
+#include "declaration.h"
+#include "ctfeprof.h"
+
+int CtfeProfile::enabled;
+Loc CtfeProfile::callsite;
+THREAD_LOCAL unsigned long long CtfeProfile::numExpressions;
+unsigned long CtfeProfile::numCalls;
+unsigned CtfeProfile::numMemoLookups;
+unsigned CtfeProfile::numMemoHits;
+unsigned CtfeProfile::numMemoized;
+
+/* Totals for a function, or for a function called from one call site.
+ */
+struct ProfEntry
+{
+    FuncDeclaration *fd;
+    const char *name;           // fd->toPrettyChars()
+    const char *site;           // "file(line)", NULL for the function totals
+    unsigned long calls;
+    int active;                 // calls of it on the profile stack
+    double incltime;
+    double excltime;
+    unsigned long long inclexps;
+    unsigned long long exclexps;
+    size_t peakstack;
+};
+
+/* A call in progress.
+ */
+struct ProfFrame
+{
+    ProfEntry *func;
+    ProfEntry *call;
+    double starttime;
+    double childtime;
+    unsigned long long startexps;
+    unsigned long long childexps;
+    size_t peakstack;
+    size_t pathlen;             // length of the folded stack up to the caller
+};
+
+static StringTable entries;     // key => ProfEntry
+static ArrayBase<ProfEntry> funcs;
+static ArrayBase<ProfEntry> calls;
+static StringTable stacks;      // folded stack => ProfEntry, excltime only
+static ArrayBase<ProfEntry> folded;
+static const char **foldednames;
+
+static ProfFrame *frames;
+static size_t nframes;
+static size_t allocframes;
+static OutBuffer path;          // folded stack of the current call
+static unsigned long totalCalls;
+
+static double now()
+{
+#if _WIN32
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static ProfEntry *getEntry(FuncDeclaration *fd, const char *site)
+{
+    OutBuffer key;
+    key.printf("%p %s", fd, site ? site : "");
+
+    StringValue *sv = entries.update((char *)key.data, key.offset);
+    ProfEntry *pe = (ProfEntry *)sv->ptrvalue;
+    if (!pe)
+    {
+        pe = new ProfEntry();
+        memset(pe, 0, sizeof(ProfEntry));
+        pe->fd = fd;
+        pe->name = fd->toPrettyChars();
+        pe->site = site ? mem.strdup(site) : NULL;
+        sv->ptrvalue = pe;
+        (site ? calls : funcs).push(pe);
+    }
+    return pe;
+}
+
+/*************************************
+ * Start timing a call of fd made at callsite.
+ */
+
+void CtfeProfile::enter(FuncDeclaration *fd, Loc callsite)
+{
+    static int initialized;
+    if (!initialized)
+    {
+        entries.init(1009);
+        stacks.init(1009);
+        initialized = 1;
+    }
+
+    if (nframes == allocframes)
+    {
+        size_t oldsize = allocframes * sizeof(ProfFrame);
+        allocframes = allocframes ? allocframes * 2 : 64;
+        frames = (ProfFrame *)mem.realloc(frames, allocframes * sizeof(ProfFrame), oldsize);
+    }
+    ProfFrame *pf = &frames[nframes++];
+
+    char *site = callsite.filename ? callsite.toChars() : (char *)"?";
+    pf->func = getEntry(fd, NULL);
+    pf->call = getEntry(fd, site);
+    pf->func->active++;
+    pf->call->active++;
+    totalCalls++;
+
+    pf->pathlen = path.offset;
+    if (nframes == 1)
+    {   // The root of the stack is where CTFE was started
+        path.writestring(site);
+        path.writeByte(';');
+    }
+    else
+        path.writeByte(';');
+    path.writestring(pf->func->name);
+
+    pf->childtime = 0;
+    pf->childexps = 0;
+    pf->peakstack = 0;
+    pf->startexps = numExpressions;
+    pf->starttime = now();
+}
+
+/*************************************
+ * Stop timing the innermost call, stackdepth is the size of the
+ * CtfeStack at its end.
+ */
+
+void CtfeProfile::leave(size_t stackdepth)
+{
+    double endtime = now();
+    assert(nframes);
+    ProfFrame *pf = &frames[--nframes];
+
+    double incltime = endtime - pf->starttime;
+    double excltime = incltime - pf->childtime;
+    unsigned long long inclexps = numExpressions - pf->startexps;
+    unsigned long long exclexps = inclexps - pf->childexps;
+    if (stackdepth > pf->peakstack)
+        pf->peakstack = stackdepth;
+
+    ProfEntry *entry[2] = { pf->func, pf->call };
+    for (int i = 0; i < 2; i++)
+    {   ProfEntry *pe = entry[i];
+
+        pe->calls++;
+        pe->excltime += excltime;
+        pe->exclexps += exclexps;
+        // Only count the outermost of recursive calls as inclusive
+        if (--pe->active == 0)
+        {   pe->incltime += incltime;
+            pe->inclexps += inclexps;
+        }
+        if (pf->peakstack > pe->peakstack)
+            pe->peakstack = pf->peakstack;
+    }
+
+    StringValue *sv = stacks.update((char *)path.data, path.offset);
+    ProfEntry *ps = (ProfEntry *)sv->ptrvalue;
+    if (!ps)
+    {
+        ps = new ProfEntry();
+        memset(ps, 0, sizeof(ProfEntry));
+        ps->site = mem.strdup(sv->lstring.toDchars());
+        sv->ptrvalue = ps;
+        folded.push(ps);
+    }
+    ps->excltime += excltime;
+    path.offset = pf->pathlen;
+
+    if (nframes)
+    {   ProfFrame *parent = &frames[nframes - 1];
+        parent->childtime += incltime;
+        parent->childexps += inclexps;
+        if (pf->peakstack > parent->peakstack)
+            parent->peakstack = pf->peakstack;
+    }
+}
+
+static int cmpEntry(const void *p1, const void *p2)
+{
+    ProfEntry *pe1 = *(ProfEntry **)p1;
+    ProfEntry *pe2 = *(ProfEntry **)p2;
+    if (pe1->excltime != pe2->excltime)
+        return pe1->excltime < pe2->excltime ? 1 : -1;
+    if (pe1->calls != pe2->calls)
+        return pe1->calls < pe2->calls ? 1 : -1;
+    return 0;
+}
+
+static void writeTable(OutBuffer *buf, ArrayBase<ProfEntry> *a)
+{
+    qsort(a->data, a->dim, sizeof(a->data[0]), &cmpEntry);
+
+    buf->printf("%10s %10s %9s %12s %12s %6s  %s\n",
+        "excl(s)", "incl(s)", "calls", "excl nodes", "incl nodes", "stack",
+        "function");
+    for (size_t i = 0; i < a->dim; i++)
+    {   ProfEntry *pe = a->tdata()[i];
+
+        buf->printf("%10.6f %10.6f %9lu %12llu %12llu %6u  %s",
+            pe->excltime, pe->incltime, pe->calls, pe->exclexps, pe->inclexps,
+            (unsigned)pe->peakstack, pe->name);
+        if (pe->site)
+            buf->printf("  called at %s", pe->site);
+        else
+            buf->printf("  %s", pe->fd->loc.toChars());
+        buf->writeByte('\n');
+    }
+}
+
+static void writeFile(const char *filename, OutBuffer *buf)
+{
+    File f((char *)filename);
+    f.setbuffer(buf->data, buf->offset);
+    f.ref = 1;
+    f.writev();
+}
+
+/*************************************
+ * Write the profile to filename, and the folded stacks to
+ * filename.folded.
+ */
+
+void CtfeProfile::write(const char *filename)
+{
+    OutBuffer buf;
+    double total = 0;
+    for (size_t i = 0; i < funcs.dim; i++)
+        total += funcs.tdata()[i]->excltime;
+
+    buf.printf("CTFE profile: %lu calls of %u functions, %.6f seconds\n",
+        totalCalls, (unsigned)funcs.dim, total);
+    buf.printf("Memo table: %u lookups, %u hits, %u results\n\n",
+        numMemoLookups, numMemoHits, numMemoized);
+    buf.writestring("Functions:\n");
+    writeTable(&buf, &funcs);
+    buf.writestring("\nCall sites:\n");
+    writeTable(&buf, &calls);
+    writeFile(filename, &buf);
+
+    /* Folded stacks, one line per distinct stack with its exclusive
+     * time in microseconds.
+     */
+    buf.reset();
+    for (size_t i = 0; i < folded.dim; i++)
+    {   ProfEntry *ps = folded.tdata()[i];
+        unsigned long usecs = (unsigned long)(ps->excltime * 1000000.0 + 0.5);
+        if (usecs)
+            buf.printf("%s %lu\n", ps->site, usecs);
+    }
+    OutBuffer name;
+    name.printf("%s.folded", filename);
+    name.writeByte(0);
+    writeFile((char *)name.data, &buf);
+}
+
+void CtfeProfile::printStats()
+{
+    fprintf(stdmsg, "ctfe calls %lu, memo lookups %u, hits %u, memoized %u\n",
+        numCalls, numMemoLookups, numMemoHits, numMemoized);
+}
@@ -0,0 +1,55 @@
+// ctfeprof.h -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef DMD_CTFEPROF_H
+#define DMD_CTFEPROF_H
+
+#ifdef __DMC__
+#pragma once
+#endif /* __DMC__ */
+
+#include "mars.h"
+
+struct FuncDeclaration;
+
+/* Profile of the functions run by CTFE. Every call to
+ * FuncDeclaration::interpret() is timed, and the time, the number of
+ * Expression nodes allocated and the CtfeStack depth are added up per
+ * function and per call site, excluding and including the callees.
+ * write() prints the tables sorted by exclusive time, and the call
+ * stacks in the folded format read by flamegraph.pl, with the location
+ * of the outermost call (the enum, mixin, static if, ...) as the root.
+ */
+
+struct CtfeProfile
+{
+    static int enabled;
+    static Loc callsite;                        // location of the CallExp being interpreted
+    static THREAD_LOCAL unsigned long long numExpressions;  // Expression nodes allocated so far by this thread
+    static unsigned long numCalls;              // functions interpreted so far, even if not enabled
+    static unsigned numMemoLookups;             // calls looked up in the memo table
+    static unsigned numMemoHits;                // calls found in the memo table
+    static unsigned numMemoized;                // results in the memo table
+
+    static void enter(FuncDeclaration *fd, Loc callsite);
+    static void leave(size_t stackdepth);
+
+    static void write(const char *filename);
+    static void printStats();
+};
+
+#endif /* DMD_CTFEPROF_H */
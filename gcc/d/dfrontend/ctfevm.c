@@ -0,0 +1,976 @@
+// ctfevm.c -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if (defined (__SVR4) && defined (__sun))
+#include <alloca.h>
+#endif
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <malloc.h>
+#endif
+
+#ifdef IN_GCC
+#include "gdc_alloca.h"
+#endif
+
+#include "rmem.h"
+#include "aav.h"
+
+#include "mars.h"
+#include "statement.h"
+#include "expression.h"
+#include "declaration.h"
+#include "init.h"
+#include "mtype.h"
+#include "ctfevm.h"
+
+#define LOG     0
+
+enum CtfeOp
+{
+    CTFEloadk,          // a = imm
+    CTFEmov,            // a = b
+    CTFEadd,            // a = b op c, normalized to kind
+    CTFEsub,
+    CTFEmul,
+    CTFEdiv,
+    CTFEudiv,
+    CTFEmod,
+    CTFEumod,
+    CTFEand,
+    CTFEor,
+    CTFExor,
+    CTFEshl,            // shifts are done in the kind of b
+    CTFEshr,
+    CTFEushr,
+    CTFEneg,            // a = op b, normalized to kind
+    CTFEcom,
+    CTFEnorm,
+    CTFEnot,            // a = b == 0
+    CTFEbool,           // a = b != 0
+    CTFEeq,             // a = b cmp c
+    CTFEne,
+    CTFElt,
+    CTFEle,
+    CTFEult,
+    CTFEule,
+    CTFEjmp,            // goto a
+    CTFEjz,             // if (b == 0) goto a
+    CTFEjnz,            // if (b != 0) goto a
+    CTFEcall,           // a = callees[imm](b .. b + c)
+    CTFEret,            // return a, normalized to kind
+    CTFEretv,           // return void
+    CTFEfail,           // give up, the interpreter redoes the call
+};
+
+/* Size and signedness of an integral value, the result of every
+ * instruction is truncated and sign or zero extended according to it,
+ * the same as IntegerExp::toInteger() does.
+ */
+enum CtfeKind
+{
+    KINDi8, KINDu8, KINDi16, KINDu16, KINDi32, KINDu32, KINDi64, KINDu64,
+};
+
+static unsigned numCompiled;    // functions compiled to bytecode
+static unsigned numRejected;    // functions left to the interpreter
+static unsigned numCalls;       // calls run in the VM
+static unsigned numFallbacks;   // calls the VM gave up on
+
+/*********************************
+ * Return !=0 if t is a type the VM can hold in a register.
+ */
+
+static int isIntegral(Type *t)
+{
+    if (!t)
+        return 0;
+    switch (t->toBasetype()->ty)
+    {
+        case Tbool:
+        case Tint8:  case Tuns8:
+        case Tint16: case Tuns16:
+        case Tint32: case Tuns32:
+        case Tint64: case Tuns64:
+        case Tchar:  case Twchar: case Tdchar:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int kindOf(Type *t)
+{
+    t = t->toBasetype();
+    int kind;
+    switch (t->size())
+    {
+        case 1: kind = KINDi8;  break;
+        case 2: kind = KINDi16; break;
+        case 4: kind = KINDi32; break;
+        case 8: kind = KINDi64; break;
+        default: assert(0);
+    }
+    return t->isunsigned() || t->ty == Tbool ? kind + 1 : kind;
+}
+
+static unsigned kindBits(int kind)
+{
+    return 8 << (kind / 2);
+}
+
+static dinteger_t normalize(int kind, dinteger_t v)
+{
+    switch (kind)
+    {
+        case KINDi8:  return (d_int8)v;
+        case KINDu8:  return (d_uns8)v;
+        case KINDi16: return (d_int16)v;
+        case KINDu16: return (d_uns16)v;
+        case KINDi32: return (d_int32)v;
+        case KINDu32: return (d_uns32)v;
+        default:      return v;
+    }
+}
+
+/******************************** CtfeCode ***************************/
+
+CtfeCode::CtfeCode()
+{
+    ok = 0;
+    nparams = 0;
+    nregs = 0;
+    code = NULL;
+    ncode = 0;
+    allocdim = 0;
+}
+
+/* Shared by all functions that can't be compiled.
+ */
+static CtfeCode unsupported;
+
+/******************************** CtfeCompiler ***************************/
+
+struct CtfeLoop
+{
+    CtfeLoop *outer;
+    ArrayBase<void> breaks;     // CTFEjmp's to patch with the loop exit
+    ArrayBase<void> continues;  // CTFEjmp's to patch with the continue target
+
+    void patch(CtfeCompiler *cc, ArrayBase<void> *jumps, size_t target)
+    {
+        for (size_t i = 0; i < jumps->dim; i++)
+            cc->patch((size_t)jumps->tdata()[i], target);
+    }
+};
+
+CtfeCompiler::CtfeCompiler(CtfeCode *code)
+{
+    this->code = code;
+    vars = NULL;
+    loop = NULL;
+}
+
+size_t CtfeCompiler::emit(int op, unsigned a, unsigned b, unsigned c, dinteger_t imm, int kind)
+{
+    if (code->ncode == code->allocdim)
+    {
+        size_t oldsize = code->allocdim * sizeof(CtfeInstr);
+        code->allocdim = code->allocdim ? code->allocdim * 2 : 16;
+        code->code = (CtfeInstr *)mem.realloc(code->code, code->allocdim * sizeof(CtfeInstr), oldsize);
+    }
+    CtfeInstr *i = &code->code[code->ncode];
+    i->op = op;
+    i->kind = kind;
+    i->a = a;
+    i->b = b;
+    i->c = c;
+    i->imm = imm;
+    return code->ncode++;
+}
+
+/*********************************
+ * Allocate a register for local variable v.
+ */
+
+int CtfeCompiler::declare(VarDeclaration *v)
+{
+    unsigned r = newReg();
+    *(size_t *)_aaGet(&vars, v) = r + 1;
+    return r;
+}
+
+/*********************************
+ * Return the register of the variable e refers to,
+ * -1 if it isn't a local of the function being compiled.
+ */
+
+int CtfeCompiler::lvalue(Expression *e)
+{
+    if (e->op != TOKvar)
+        return -1;
+    VarDeclaration *v = ((VarExp *)e)->var->isVarDeclaration();
+    if (!v)
+        return -1;
+    size_t r = (size_t)_aaGetRvalue(vars, v);
+    return r ? r - 1 : -1;
+}
+
+/*********************************
+ * Generate code to evaluate e.
+ * Returns:
+ *      register with the value of e
+ *      -1      e can't be compiled
+ */
+
+int CtfeCompiler::exp(Expression *e)
+{
+    int r, r1, r2, op;
+    BinExp *be;
+
+    switch (e->op)
+    {
+        case TOKint64:
+            if (!isIntegral(e->type))
+                return -1;
+            r = newReg();
+            emit(CTFEloadk, r, 0, 0, e->toInteger());
+            return r;
+
+        case TOKvar:
+        {   VarExp *ve = (VarExp *)e;
+            VarDeclaration *v = ve->var->isVarDeclaration();
+            if (!v || !isIntegral(e->type))
+                return -1;
+            r1 = lvalue(e);
+            r = newReg();
+            if (r1 >= 0)
+            {   // Copy, later side effects in the same expression may change v
+                emit(CTFEmov, r, r1);
+                return r;
+            }
+            if (v->storage_class & STCmanifest && v->init)
+            {   ExpInitializer *ie = v->init->isExpInitializer();
+                if (ie && ie->exp->op == TOKint64)
+                {   emit(CTFEloadk, r, 0, 0, normalize(kindOf(e->type), ie->exp->toInteger()));
+                    return r;
+                }
+            }
+            return -1;
+        }
+
+        case TOKdeclaration:
+        {   Dsymbol *s = ((DeclarationExp *)e)->declaration;
+            VarDeclaration *v = s->isVarDeclaration();
+            if (!v)
+                return -1;
+            r = newReg();
+            if (v->storage_class & STCmanifest)
+                return r;
+            if (v->isDataseg() || !isIntegral(v->type) ||
+                v->storage_class & (STCref | STCout | STClazy) || !v->init)
+                return -1;
+            r1 = declare(v);
+            if (v->init->isVoidInitializer())
+            {   emit(CTFEloadk, r1);
+                return r;
+            }
+            ExpInitializer *ie = v->init->isExpInitializer();
+            if (!ie || exp(ie->exp) < 0)
+                return -1;
+            return r;
+        }
+
+        case TOKassign:
+        case TOKconstruct:
+        case TOKblit:
+            be = (BinExp *)e;
+            r1 = lvalue(be->e1);
+            if (r1 < 0 || !isIntegral(be->e1->type) || !isIntegral(be->e2->type))
+                return -1;
+            r = exp(be->e2);
+            if (r < 0)
+                return -1;
+            emit(CTFEnorm, r, r, 0, 0, kindOf(be->e1->type));
+            emit(CTFEmov, r1, r);
+            return r;
+
+        case TOKaddass:  op = CTFEadd;  goto Lopass;
+        case TOKminass:  op = CTFEsub;  goto Lopass;
+        case TOKmulass:  op = CTFEmul;  goto Lopass;
+        case TOKandass:  op = CTFEand;  goto Lopass;
+        case TOKorass:   op = CTFEor;   goto Lopass;
+        case TOKxorass:  op = CTFExor;  goto Lopass;
+        case TOKshlass:  op = CTFEshl;  goto Lopass;
+        case TOKshrass:  op = CTFEshr;  goto Lopass;
+        case TOKushrass: op = CTFEushr; goto Lopass;
+        case TOKdivass:
+        case TOKmodass:
+            be = (BinExp *)e;
+            if (be->e1->type->isunsigned() || be->e2->type->isunsigned())
+                op = e->op == TOKdivass ? CTFEudiv : CTFEumod;
+            else
+                op = e->op == TOKdivass ? CTFEdiv : CTFEmod;
+        Lopass:
+            be = (BinExp *)e;
+            r1 = lvalue(be->e1);
+            if (r1 < 0 || !isIntegral(be->e1->type) || !isIntegral(be->e2->type))
+                return -1;
+            r2 = exp(be->e2);
+            if (r2 < 0)
+                return -1;
+            r = newReg();
+            emit(op, r, r1, r2, 0, kindOf(be->e1->type));
+            emit(CTFEmov, r1, r);
+            return r;
+
+        case TOKplusplus:
+        case TOKminusminus:
+            be = (BinExp *)e;
+            r1 = lvalue(be->e1);
+            if (r1 < 0 || !isIntegral(be->e1->type) || !isIntegral(be->e2->type))
+                return -1;
+            r = newReg();
+            emit(CTFEmov, r, r1);
+            r2 = exp(be->e2);
+            if (r2 < 0)
+                return -1;
+            emit(e->op == TOKplusplus ? CTFEadd : CTFEsub, r1, r1, r2, 0, kindOf(be->e1->type));
+            return r;
+
+        case TOKadd:    op = CTFEadd;  goto Lbin;
+        case TOKmin:    op = CTFEsub;  goto Lbin;
+        case TOKmul:    op = CTFEmul;  goto Lbin;
+        case TOKand:    op = CTFEand;  goto Lbin;
+        case TOKor:     op = CTFEor;   goto Lbin;
+        case TOKxor:    op = CTFExor;  goto Lbin;
+        case TOKshl:    op = CTFEshl;  goto Lbin;
+        case TOKshr:    op = CTFEshr;  goto Lbin;
+        case TOKushr:   op = CTFEushr; goto Lbin;
+        case TOKdiv:
+        case TOKmod:
+            be = (BinExp *)e;
+            if (be->e1->type->isunsigned() || be->e2->type->isunsigned())
+                op = e->op == TOKdiv ? CTFEudiv : CTFEumod;
+            else
+                op = e->op == TOKdiv ? CTFEdiv : CTFEmod;
+        Lbin:
+        {   be = (BinExp *)e;
+            if (!isIntegral(e->type) || !isIntegral(be->e1->type) || !isIntegral(be->e2->type))
+                return -1;
+            r1 = exp(be->e1);
+            r2 = r1 < 0 ? -1 : exp(be->e2);
+            if (r2 < 0)
+                return -1;
+            r = newReg();
+            int isshift = op == CTFEshl || op == CTFEshr || op == CTFEushr;
+            int kind = kindOf(e->type);
+            emit(op, r, r1, r2, 0, isshift ? kindOf(be->e1->type) : kind);
+            if (isshift && kind != kindOf(be->e1->type))
+                emit(CTFEnorm, r, r, 0, 0, kind);
+            return r;
+        }
+
+        case TOKequal:
+        case TOKidentity:       op = CTFEeq; goto Lcmp;
+        case TOKnotequal:
+        case TOKnotidentity:    op = CTFEne; goto Lcmp;
+        case TOKlt:
+        case TOKgt:             op = CTFElt; goto Lcmp;
+        case TOKle:
+        case TOKge:             op = CTFEle; goto Lcmp;
+        Lcmp:
+        {   be = (BinExp *)e;
+            if (!isIntegral(be->e1->type) || !isIntegral(be->e2->type))
+                return -1;
+            if ((op == CTFElt || op == CTFEle) &&
+                (be->e1->type->isunsigned() || be->e2->type->isunsigned()))
+                op = op == CTFElt ? CTFEult : CTFEule;
+            r1 = exp(be->e1);
+            r2 = r1 < 0 ? -1 : exp(be->e2);
+            if (r2 < 0)
+                return -1;
+            r = newReg();
+            if (e->op == TOKgt || e->op == TOKge)
+                emit(op, r, r2, r1);
+            else
+                emit(op, r, r1, r2);
+            return r;
+        }
+
+        case TOKandand:
+        case TOKoror:
+        {   be = (BinExp *)e;
+            if (!isIntegral(be->e1->type) || !isIntegral(be->e2->type))
+                return -1;
+            r = newReg();
+            r1 = exp(be->e1);
+            if (r1 < 0)
+                return -1;
+            emit(CTFEbool, r, r1);
+            size_t j = emit(e->op == TOKandand ? CTFEjz : CTFEjnz, 0, r);
+            r2 = exp(be->e2);
+            if (r2 < 0)
+                return -1;
+            emit(CTFEbool, r, r2);
+            patch(j, here());
+            return r;
+        }
+
+        case TOKquestion:
+        {   CondExp *ce = (CondExp *)e;
+            if (!isIntegral(e->type) || !isIntegral(ce->econd->type))
+                return -1;
+            r = newReg();
+            int rc = exp(ce->econd);
+            if (rc < 0)
+                return -1;
+            size_t jfalse = emit(CTFEjz, 0, rc);
+            r1 = exp(ce->e1);
+            if (r1 < 0)
+                return -1;
+            emit(CTFEmov, r, r1);
+            size_t jend = emit(CTFEjmp, 0);
+            patch(jfalse, here());
+            r2 = exp(ce->e2);
+            if (r2 < 0)
+                return -1;
+            emit(CTFEmov, r, r2);
+            patch(jend, here());
+            return r;
+        }
+
+        case TOKcomma:
+            be = (BinExp *)e;
+            if (exp(be->e1) < 0)
+                return -1;
+            return exp(be->e2);
+
+        case TOKneg:    op = CTFEneg;  goto Luna;
+        case TOKtilde:  op = CTFEcom;  goto Luna;
+        case TOKnot:    op = CTFEnot;  goto Luna;
+        Luna:
+        {   UnaExp *ue = (UnaExp *)e;
+            if (!isIntegral(e->type) || !isIntegral(ue->e1->type))
+                return -1;
+            r1 = exp(ue->e1);
+            if (r1 < 0)
+                return -1;
+            r = newReg();
+            emit(op, r, r1, 0, 0, kindOf(e->type));
+            return r;
+        }
+
+        case TOKcast:
+        {   CastExp *ce = (CastExp *)e;
+            if (!isIntegral(e->type) || !isIntegral(ce->e1->type))
+                return -1;
+            r1 = exp(ce->e1);
+            if (r1 < 0)
+                return -1;
+            r = newReg();
+            if (e->type->toBasetype()->ty == Tbool)
+                emit(CTFEbool, r, r1);
+            else
+                emit(CTFEnorm, r, r1, 0, 0, kindOf(e->type));
+            return r;
+        }
+
+        case TOKcall:
+        {   CallExp *ce = (CallExp *)e;
+            Type *tret = e->type->toBasetype();
+            if (ce->e1->op != TOKvar || !(tret->ty == Tvoid || isIntegral(tret)))
+                return -1;
+            FuncDeclaration *f = ((VarExp *)ce->e1)->var->isFuncDeclaration();
+            if (!f || f->isNested() || f->needThis() || !f->fbody ||
+                (f->ctfeCode && !f->ctfeCode->ok))
+                return -1;
+            size_t nargs = ce->arguments ? ce->arguments->dim : 0;
+            if (nargs != (f->parameters ? f->parameters->dim : 0))
+                return -1;
+
+            int *regs = (int *)alloca(nargs * sizeof(int));
+            for (size_t i = 0; i < nargs; i++)
+            {   Expression *earg = ce->arguments->tdata()[i];
+                if (!isIntegral(earg->type) || (regs[i] = exp(earg)) < 0)
+                    return -1;
+            }
+            // Arguments go in consecutive registers
+            unsigned base = code->nregs;
+            for (size_t i = 0; i < nargs; i++)
+                emit(CTFEmov, newReg(), regs[i]);
+            r = newReg();
+            emit(CTFEcall, r, base, nargs, code->callees.dim);
+            code->callees.push(f);
+            return r;
+        }
+
+        case TOKassert:
+        {   AssertExp *ae = (AssertExp *)e;
+            if (!isIntegral(ae->e1->type))
+                return -1;
+            r1 = exp(ae->e1);
+            if (r1 < 0)
+                return -1;
+            // The interpreter reports the failure, with the message
+            size_t j = emit(CTFEjnz, 0, r1);
+            emit(CTFEfail, 0);
+            patch(j, here());
+            return newReg();
+        }
+
+        case TOKhalt:
+            emit(CTFEfail, 0);
+            return newReg();
+
+        default:
+            return -1;
+    }
+}
+
+/*********************************
+ * Generate an unpatched jump for break or continue in the innermost loop.
+ */
+
+int CtfeCompiler::breakJump(int iscontinue)
+{
+    if (!loop)
+        return 0;
+    size_t j = emit(CTFEjmp, 0);
+    if (iscontinue)
+        loop->continues.push((void *)j);
+    else
+        loop->breaks.push((void *)j);
+    return 1;
+}
+
+/*********************************
+ * Compile fd to bytecode.
+ * Returns:
+ *      code, with ok==0 if fd can't be run by the VM
+ */
+
+CtfeCode *CtfeCompiler::compile(FuncDeclaration *fd)
+{
+#if LOG
+    printf("CtfeCompiler::compile(%s)\n", fd->toChars());
+#endif
+    TypeFunction *tf = (TypeFunction *)fd->type->toBasetype();
+    assert(tf->ty == Tfunction);
+    Type *tret = tf->next ? tf->next->toBasetype() : NULL;
+
+    if (!fd->fbody || fd->isNested() || fd->needThis() || fd->vresult ||
+        fd->v_arguments || tf->varargs || tf->isref || fd->naked ||
+        !tret || !(tret->ty == Tvoid || isIntegral(tret)))
+        goto Lunsupported;
+#if DMDV2
+    if (fd->isBuiltin() != BUILTINnot)
+        goto Lunsupported;
+#endif
+
+    {
+        CtfeCode *code = new CtfeCode();
+        CtfeCompiler cc(code);
+
+        code->nparams = fd->parameters ? fd->parameters->dim : 0;
+        for (size_t i = 0; i < code->nparams; i++)
+        {   VarDeclaration *v = fd->parameters->tdata()[i];
+            if (v->storage_class & (STCref | STCout | STClazy) || !isIntegral(v->type))
+                goto Lunsupported;
+            cc.declare(v);
+        }
+
+        if (!fd->fbody->ctfeCompile(&cc))
+            goto Lunsupported;
+
+        // Fell off the end
+        if (tret->ty == Tvoid)
+            cc.emit(CTFEretv, 0);
+        else
+            cc.emit(CTFEfail, 0);
+
+        // execute() reads registers b and c of every instruction
+        if (!code->nregs)
+            code->nregs = 1;
+        code->ok = 1;
+        numCompiled++;
+        return code;
+    }
+
+Lunsupported:
+#if LOG
+    printf("\tcan't compile %s\n", fd->toChars());
+#endif
+    numRejected++;
+    return &unsupported;
+}
+
+/******************************** Statement ***************************/
+
+int Statement::ctfeCompile(CtfeCompiler *cc)
+{
+    return 0;
+}
+
+int ExpStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    return !exp || cc->exp(exp) >= 0;
+}
+
+int CompoundStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    for (size_t i = 0; i < statements->dim; i++)
+    {   Statement *s = statements->tdata()[i];
+        if (s && !s->ctfeCompile(cc))
+            return 0;
+    }
+    return 1;
+}
+
+int ScopeStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    return !statement || statement->ctfeCompile(cc);
+}
+
+int IfStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    if (match || !isIntegral(condition->type))
+        return 0;
+    int r = cc->exp(condition);
+    if (r < 0)
+        return 0;
+    size_t jelse = cc->emit(CTFEjz, 0, r);
+    if (ifbody && !ifbody->ctfeCompile(cc))
+        return 0;
+    if (elsebody)
+    {
+        size_t jend = cc->emit(CTFEjmp, 0);
+        cc->patch(jelse, cc->here());
+        if (!elsebody->ctfeCompile(cc))
+            return 0;
+        cc->patch(jend, cc->here());
+    }
+    else
+        cc->patch(jelse, cc->here());
+    return 1;
+}
+
+int ForStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    if (init && !init->ctfeCompile(cc))
+        return 0;
+
+    CtfeLoop loop;
+    loop.outer = cc->loop;
+    cc->loop = &loop;
+
+    int result = 0;
+    size_t top = cc->here();
+    size_t jexit = 0;
+    if (condition)
+    {
+        int r = isIntegral(condition->type) ? cc->exp(condition) : -1;
+        if (r < 0)
+            goto Lret;
+        jexit = cc->emit(CTFEjz, 0, r);
+    }
+    if (body && !body->ctfeCompile(cc))
+        goto Lret;
+    loop.patch(cc, &loop.continues, cc->here());
+    if (increment && cc->exp(increment) < 0)
+        goto Lret;
+    cc->emit(CTFEjmp, top);
+    if (condition)
+        cc->patch(jexit, cc->here());
+    loop.patch(cc, &loop.breaks, cc->here());
+    result = 1;
+
+Lret:
+    cc->loop = loop.outer;
+    return result;
+}
+
+int DoStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    CtfeLoop loop;
+    loop.outer = cc->loop;
+    cc->loop = &loop;
+
+    int result = 0;
+    size_t top = cc->here();
+    int r;
+    if (body && !body->ctfeCompile(cc))
+        goto Lret;
+    loop.patch(cc, &loop.continues, cc->here());
+    r = isIntegral(condition->type) ? cc->exp(condition) : -1;
+    if (r < 0)
+        goto Lret;
+    cc->emit(CTFEjnz, top, r);
+    loop.patch(cc, &loop.breaks, cc->here());
+    result = 1;
+
+Lret:
+    cc->loop = loop.outer;
+    return result;
+}
+
+int ReturnStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    if (!exp)
+    {
+        cc->emit(CTFEretv, 0);
+        return 1;
+    }
+    if (!isIntegral(exp->type))
+        return 0;
+    int r = cc->exp(exp);
+    if (r < 0)
+        return 0;
+    cc->emit(CTFEret, r, 0, 0, 0, kindOf(exp->type));
+    return 1;
+}
+
+int BreakStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    return !ident && cc->breakJump(0);
+}
+
+int ContinueStatement::ctfeCompile(CtfeCompiler *cc)
+{
+    return !ident && cc->breakJump(1);
+}
+
+/******************************** CtfeVM ***************************/
+
+enum { EXECfail, EXECvalue, EXECvoid };
+
+/* The registers of all active frames, a frame is addressed by its
+ * offset since the stack can move when it grows.
+ */
+static dinteger_t *vmstack;
+static size_t vmstackdim;
+
+static void reserve(size_t dim)
+{
+    if (dim > vmstackdim)
+    {
+        size_t oldsize = vmstackdim * sizeof(dinteger_t);
+        vmstackdim = dim < 1024 ? 1024 : dim * 2;
+        vmstack = (dinteger_t *)mem.realloc(vmstack, vmstackdim * sizeof(dinteger_t), oldsize);
+    }
+}
+
+static CtfeCode *getCode(FuncDeclaration *fd)
+{
+    if (!fd->ctfeCode)
+        fd->ctfeCode = CtfeCompiler::compile(fd);
+    return fd->ctfeCode;
+}
+
+/*********************************
+ * Execute code with its registers starting at vmstack[base].
+ */
+
+static int execute(CtfeCode *code, size_t base, int depth, dinteger_t *presult)
+{
+    CtfeInstr *pc = code->code;
+    dinteger_t *regs = vmstack + base;
+
+    while (1)
+    {
+        CtfeInstr *i = pc++;
+        dinteger_t b = regs[i->b];
+        dinteger_t c = regs[i->c];
+
+        switch (i->op)
+        {
+            case CTFEloadk:     regs[i->a] = i->imm;                            break;
+            case CTFEmov:       regs[i->a] = b;                                 break;
+            case CTFEadd:       regs[i->a] = normalize(i->kind, b + c);         break;
+            case CTFEsub:       regs[i->a] = normalize(i->kind, b - c);         break;
+            case CTFEmul:       regs[i->a] = normalize(i->kind, b * c);         break;
+            case CTFEand:       regs[i->a] = normalize(i->kind, b & c);         break;
+            case CTFEor:        regs[i->a] = normalize(i->kind, b | c);         break;
+            case CTFExor:       regs[i->a] = normalize(i->kind, b ^ c);         break;
+            case CTFEneg:       regs[i->a] = normalize(i->kind, -b);            break;
+            case CTFEcom:       regs[i->a] = normalize(i->kind, ~b);            break;
+            case CTFEnorm:      regs[i->a] = normalize(i->kind, b);             break;
+            case CTFEnot:       regs[i->a] = b == 0;                            break;
+            case CTFEbool:      regs[i->a] = b != 0;                            break;
+            case CTFEeq:        regs[i->a] = b == c;                            break;
+            case CTFEne:        regs[i->a] = b != c;                            break;
+            case CTFElt:        regs[i->a] = (sinteger_t)b < (sinteger_t)c;     break;
+            case CTFEle:        regs[i->a] = (sinteger_t)b <= (sinteger_t)c;    break;
+            case CTFEult:       regs[i->a] = b < c;                             break;
+            case CTFEule:       regs[i->a] = b <= c;                            break;
+
+            case CTFEdiv:
+                if (c == 0)
+                    return EXECfail;
+                if ((sinteger_t)c == -1)
+                    regs[i->a] = normalize(i->kind, -b);
+                else
+                    regs[i->a] = normalize(i->kind, (sinteger_t)b / (sinteger_t)c);
+                break;
+
+            case CTFEmod:
+                if (c == 0 || (sinteger_t)c == -1)
+                    return EXECfail;
+                regs[i->a] = normalize(i->kind, (sinteger_t)b % (sinteger_t)c);
+                break;
+
+            case CTFEudiv:
+                if (c == 0)
+                    return EXECfail;
+                regs[i->a] = normalize(i->kind, b / c);
+                break;
+
+            case CTFEumod:
+                if (c == 0)
+                    return EXECfail;
+                regs[i->a] = normalize(i->kind, b % c);
+                break;
+
+            case CTFEshl:
+                if (c >= kindBits(i->kind))
+                    return EXECfail;
+                regs[i->a] = normalize(i->kind, b << c);
+                break;
+
+            case CTFEshr:
+                if (c >= kindBits(i->kind))
+                    return EXECfail;
+                // b is sign extended for signed kinds
+                if (i->kind & 1)
+                    regs[i->a] = normalize(i->kind, b >> c);
+                else
+                    regs[i->a] = normalize(i->kind, (sinteger_t)b >> c);
+                break;
+
+            case CTFEushr:
+                if (c >= kindBits(i->kind))
+                    return EXECfail;
+                regs[i->a] = normalize(i->kind, normalize(i->kind | 1, b) >> c);
+                break;
+
+            case CTFEjmp:
+                pc = code->code + i->a;
+                break;
+
+            case CTFEjz:
+                if (b == 0)
+                    pc = code->code + i->a;
+                break;
+
+            case CTFEjnz:
+                if (b != 0)
+                    pc = code->code + i->a;
+                break;
+
+            case CTFEcall:
+            {   FuncDeclaration *f = code->callees.tdata()[i->imm];
+                if (depth >= CTFE_RECURSION_LIMIT || f->semanticRun < PASSsemantic3done)
+                    return EXECfail;
+                CtfeCode *fc = getCode(f);
+                if (!fc->ok)
+                    return EXECfail;
+
+                size_t fbase = base + code->nregs;
+                reserve(fbase + fc->nregs);
+                regs = vmstack + base;
+                memcpy(vmstack + fbase, regs + i->b, i->c * sizeof(dinteger_t));
+
+                dinteger_t result = 0;
+                if (execute(fc, fbase, depth + 1, &result) == EXECfail)
+                    return EXECfail;
+                regs = vmstack + base;
+                regs[i->a] = result;
+                break;
+            }
+
+            case CTFEret:
+                *presult = normalize(i->kind, regs[i->a]);
+                return EXECvalue;
+
+            case CTFEretv:
+                return EXECvoid;
+
+            case CTFEfail:
+                return EXECfail;
+
+            default:
+                assert(0);
+        }
+    }
+}
+
+/*********************************
+ * Run fd in the VM with the already interpreted arguments.
+ * Returns:
+ *      NULL    fd can't be run by the VM, or it gave up; use the interpreter
+ *      result of the call otherwise
+ */
+
+Expression *CtfeVM::run(FuncDeclaration *fd, Expressions *arguments, int depth)
+{
+    CtfeCode *code = getCode(fd);
+    if (!code->ok)
+        return NULL;
+
+    size_t nargs = arguments ? arguments->dim : 0;
+    if (nargs != code->nparams)
+        return NULL;
+    for (size_t i = 0; i < nargs; i++)
+    {
+        if (arguments->tdata()[i]->op != TOKint64)
+            return NULL;
+    }
+
+    // Frames of an outer VM call can't be live here, a VM call never
+    // goes back into the interpreter.
+    reserve(code->nregs);
+    for (size_t i = 0; i < nargs; i++)
+    {   VarDeclaration *v = fd->parameters->tdata()[i];
+        vmstack[i] = normalize(kindOf(v->type), arguments->tdata()[i]->toInteger());
+    }
+
+    numCalls++;
+    dinteger_t result;
+    switch (execute(code, 0, depth + 1, &result))
+    {
+        case EXECvalue:
+            return new IntegerExp(fd->loc, result, fd->type->nextOf());
+
+        case EXECvoid:
+            return EXP_VOID_INTERPRET;
+
+        default:
+            numFallbacks++;
+            return NULL;
+    }
+}
+
+void CtfeVM::printStats()
+{
+    printf("bytecode functions = %u\trejected = %u\n", numCompiled, numRejected);
+    printf("bytecode calls = %u\tfallbacks = %u\n", numCalls, numFallbacks);
+}
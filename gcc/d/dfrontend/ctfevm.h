@@ -0,0 +1,98 @@
+// ctfevm.h -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef DMD_CTFEVM_H
+#define DMD_CTFEVM_H
+
+#ifdef __DMC__
+#pragma once
+#endif /* __DMC__ */
+
+#include "mars.h"
+#include "arraytypes.h"
+
+struct Expression;
+struct FuncDeclaration;
+struct VarDeclaration;
+struct AA;
+struct Type;
+
+// Maximum allowable recursive function calls in CTFE
+#define CTFE_RECURSION_LIMIT 1000
+
+/* Functions evaluated at compile time are compiled on first use to
+ * a register bytecode, which is run by CtfeVM::run() with the values
+ * kept as native integers instead of as literal Expressions.
+ * Only functions whose parameters, locals and result are integral
+ * scalars are compiled; there are no floating point or array slots,
+ * so anything else is left to the tree walking interpreter in
+ * interpret.c.  So is any call where the bytecode hits an error
+ * (divide by zero, a failed assert, ...) so the interpreter can
+ * report it.
+ */
+
+struct CtfeInstr
+{
+    unsigned char op;           // CtfeOp
+    unsigned char kind;         // size and signedness of the result
+    unsigned a, b, c;           // registers or jump target
+    dinteger_t imm;             // constant or index into callees[]
+};
+
+struct CtfeCode
+{
+    int ok;                     // !=0 if the function can run in the VM
+    unsigned nparams;           // parameters are in the first registers
+    unsigned nregs;             // registers in a frame
+    CtfeInstr *code;
+    size_t ncode;
+    size_t allocdim;
+    FuncDeclarations callees;   // functions called by CTFEcall
+
+    CtfeCode();
+};
+
+struct CtfeLoop;
+
+struct CtfeCompiler
+{
+    CtfeCode *code;
+    AA *vars;                   // VarDeclaration => register + 1
+    CtfeLoop *loop;             // innermost loop, for break and continue
+
+    CtfeCompiler(CtfeCode *code);
+
+    size_t emit(int op, unsigned a, unsigned b = 0, unsigned c = 0, dinteger_t imm = 0, int kind = 0);
+    size_t here() { return code->ncode; }
+    void patch(size_t i, size_t target) { code->code[i].a = target; }
+    unsigned newReg() { return code->nregs++; }
+
+    int lvalue(Expression *e);
+    int declare(VarDeclaration *v);
+    int exp(Expression *e);
+    int breakJump(int iscontinue);
+
+    static CtfeCode *compile(FuncDeclaration *fd);
+};
+
+struct CtfeVM
+{
+    static Expression *run(FuncDeclaration *fd, Expressions *arguments, int depth);
+    static void printStats();
+};
+
+#endif /* DMD_CTFEVM_H */
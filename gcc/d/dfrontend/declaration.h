@@ -37,6 +37,7 @@ struct ExpInitializer;
 struct StructDeclaration;
 struct TupleType;
 struct InterState;
+struct CtfeCode;
 struct IRState;
 
 enum PROT;
@@ -605,6 +606,8 @@ struct FuncDeclaration : Declaration
     VarDeclaration *nrvo_var;           // variable to replace with shidden
     Symbol *shidden;                    // hidden pointer passed to function
 
+    CtfeCode *ctfeCode;                 // bytecode for CTFE, NULL if not compiled yet
+
 #if DMDV2
     enum BUILTIN builtin;               // set if this is a known, builtin
                                         // function we can evaluate at compile
@@ -683,7 +686,14 @@ struct FuncDeclaration : Declaration
     Expression *interpret(InterState *istate, Expressions *arguments, Expression *thisexp = NULL);
     void inlineScan();
     int canInline(int hasthis, int hdrscan, int statementsToo);
+#ifdef IN_GCC
+    int canInlineImport();
+    int canInlineApply(FuncLiteralDeclaration *fdg);
+#endif
     Expression *expandInline(InlineScanState *iss, Expression *ethis, Expressions *arguments, Statement **ps);
+#ifdef IN_GCC
+    Statement *expandApply(InlineScanState *iss, Expression *ethis, FuncLiteralDeclaration *fdg);
+#endif
     const char *kind();
     void toDocBuffer(OutBuffer *buf);
     FuncDeclaration *isUnique();
@@ -978,7 +978,8 @@ void ScopeDsymbol::importScope(Dsymbol *s, enum PROT protection)
             }
         }
         imports->push(s);
-        prots = (unsigned char *)mem.realloc(prots, imports->dim * sizeof(prots[0]));
+        prots = (unsigned char *)mem.realloc(prots, imports->dim * sizeof(prots[0]),
+                                             (imports->dim - 1) * sizeof(prots[0]));
         prots[imports->dim - 1] = protection;
     }
 }
@@ -1484,6 +1485,18 @@ Dsymbol *DsymbolTable::insert(Identifier *ident, Dsymbol *s)
 #endif
 }
 
+void DsymbolTable::remove(Identifier *ident)
+{
+#if STRINGTABLE
+    StringValue *sv = tab->lookup((char*)ident->string, ident->len);
+    if (sv)
+        sv->ptrvalue = NULL;
+#else
+    if (_aaGetRvalue(tab, ident))
+        *_aaGet(&tab, ident) = NULL;
+#endif
+}
+
 Dsymbol *DsymbolTable::update(Dsymbol *s)
 {
     Identifier *ident = s->ident;
@@ -350,6 +350,9 @@ struct DsymbolTable : Object
     // Look for Dsymbol in table. If there, return it. If not, insert s and return that.
     Dsymbol *update(Dsymbol *s);
     Dsymbol *insert(Identifier *ident, Dsymbol *s);     // when ident and s are not the same
+
+    // Remove Identifier from table, if there.
+    void remove(Identifier *ident);
 };
 
 #endif /* DMD_DSYMBOL_H */
@@ -51,6 +51,7 @@ extern "C" char * __cdecl __locale_decpoint;
 #include "hdrgen.h"
 #include "parse.h"
 #include "doc.h"
+#include "ctfeprof.h"
 
 
 Expression *createTypeInfoArray(Scope *sc, Expression *args[], unsigned dim);
@@ -1319,6 +1320,7 @@ Expression::Expression(Loc loc, enum TOK op, int size)
     this->size = size;
     this->parens = 0;
     type = NULL;
+    CtfeProfile::numExpressions++;
 }
 
 Expression *Expression::syntaxCopy()
@@ -9582,12 +9584,14 @@ IndexExp::IndexExp(Loc loc, Expression *e1, Expression *e2)
     //printf("IndexExp::IndexExp('%s')\n", toChars());
     lengthVar = NULL;
     modifiable = 0;     // assume it is an rvalue
+    skipboundscheck = 0;
 }
 
 Expression *IndexExp::syntaxCopy()
 {
     IndexExp *ie = new IndexExp(loc, e1->syntaxCopy(), e2->syntaxCopy());
     ie->lengthVar = this->lengthVar;    // bug7871
+    ie->skipboundscheck = skipboundscheck;
     return ie;
 }
 
@@ -1194,6 +1194,7 @@ struct IndexExp : BinExp
 {
     VarDeclaration *lengthVar;
     int modifiable;
+    int skipboundscheck;        // index is known to be in bounds
 
     IndexExp(Loc loc, Expression *e1, Expression *e2);
     Expression *syntaxCopy();
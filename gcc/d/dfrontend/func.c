@@ -92,6 +92,7 @@ FuncDeclaration::FuncDeclaration(Loc loc, Loc endloc, Identifier *id, StorageCla
     nrvo_can = 1;
     nrvo_var = NULL;
     shidden = NULL;
+    ctfeCode = NULL;
 #if DMDV2
     builtin = BUILTINunknown;
     tookAddressOf = 0;
@@ -83,11 +83,11 @@ int Identifier::dyncast()
 
 // BUG: these are redundant with Lexer::uniqueId()
 
+THREAD_LOCAL size_t Identifier::generateNum = 0;
+
 Identifier *Identifier::generateId(const char *prefix)
 {
-    static size_t i;
-
-    return generateId(prefix, ++i);
+    return generateId(prefix, ++generateNum);
 }
 
 Identifier *Identifier::generateId(const char *prefix, size_t i)
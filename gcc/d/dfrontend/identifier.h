@@ -16,6 +16,7 @@
 #endif /* __DMC__ */
 
 #include "root.h"
+#include "rmem.h"
 
 struct Identifier : Object
 {
@@ -33,6 +34,7 @@ struct Identifier : Object
     const char *toHChars2();
     int dyncast();
 
+    static THREAD_LOCAL size_t generateNum;   // last number used by generateId(), see -fparse-threads
     static Identifier *generateId(const char *prefix);
     static Identifier *generateId(const char *prefix, size_t i);
 };
@@ -0,0 +1,396 @@
+// impcache.c -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <assert.h>
+
+#if !_WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#if (defined (__SVR4) && defined (__sun))
+#include <alloca.h>
+#endif
+
+#ifdef IN_GCC
+#include "gdc_alloca.h"
+#endif
+
+#include "rmem.h"
+#include "root.h"
+#include "stringtable.h"
+
+#include "mars.h"
+#include "impcache.h"
+
+/* Lookup statistics, printed with -v.
+ */
+static unsigned numLookups;     // calls to ImportCache::exists()
+static unsigned numStats;       // stat() calls made on directories
+static unsigned numListed;      // directories read with readdir()
+static unsigned numReused;      // directory listings taken from the cache file
+static double lookupTime;       // seconds spent in ImportCache::exists()
+
+#if _WIN32
+
+/* No directory listings on Windows, every lookup goes to the file system.
+ */
+
+int ImportCache::exists(const char *dir, const char *name)
+{
+    numLookups++;
+    char *n = FileName::combine(dir, name);
+    int result = FileName::exists(n) == 1;
+    if (n != name)
+        mem.free(n);
+    return result;
+}
+
+void ImportCache::load(const char *filename)
+{
+}
+
+void ImportCache::save(const char *filename)
+{
+}
+
+void ImportCache::reset()
+{
+}
+
+#else
+
+struct DirListing
+{
+    char *path;
+    long mtime;         // st_mtime of the directory when it was listed
+    int exists;         // 0 if the directory could not be read
+    int fromfile;       // listing came from the cache file and is not yet validated
+    Strings names;      // entries of the directory
+};
+
+static int initialized;
+static StringTable dirs;                // canonical directory path => DirListing
+static StringTable paths;               // directory path as given => DirListing
+static StringTable files;               // directory path '/' entry name => 1
+static ArrayBase<DirListing> listings;  // all DirListing's, in creation order
+
+static void initialize()
+{
+    if (!initialized)
+    {
+        dirs.init();
+        paths.init();
+        files.init(1009);
+        initialized = 1;
+    }
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*********************************
+ * Build the key for dir/name in buf. On case insensitive file systems
+ * the key is folded to lower case.
+ */
+
+static void fileKey(OutBuffer *buf, const char *dir, size_t dirlen, const char *name)
+{
+    buf->reset();
+    buf->write(dir, dirlen);
+    buf->writeByte('/');
+    buf->writestring(name);
+#if __APPLE__
+    for (size_t i = 0; i < buf->offset; i++)
+        buf->data[i] = tolower(buf->data[i]);
+#endif
+}
+
+static DirListing *newListing(const char *dir, size_t dirlen)
+{
+    DirListing *dl = new DirListing();
+    dl->path = mem.strdup(dir);
+    dl->mtime = 0;
+    dl->exists = 0;
+    dl->fromfile = 0;
+    dirs.update(dir, dirlen)->ptrvalue = dl;
+    listings.push(dl);
+    return dl;
+}
+
+/*********************************
+ * Enter the names of a listing into the files table.
+ */
+
+static void enterNames(DirListing *dl)
+{
+    OutBuffer buf;
+    size_t dirlen = strlen(dl->path);
+
+    for (size_t i = 0; i < dl->names.dim; i++)
+    {
+        fileKey(&buf, dl->path, dirlen, dl->names[i]);
+        files.update((char *)buf.data, buf.offset)->intvalue = 1;
+    }
+}
+
+/*********************************
+ * Return the listing of directory dir[0..dirlen], reading the
+ * directory the first time it is asked for. Listings are kept by
+ * canonical path, so a directory reached through several import
+ * paths is only read once.
+ */
+
+static DirListing *getListing(const char *dir, size_t dirlen)
+{
+    StringValue *sv = paths.lookup(dir, dirlen);
+    DirListing *dl = sv ? (DirListing *)sv->ptrvalue : NULL;
+    if (dl && !dl->fromfile)
+        return dl;
+
+    char *path = (char *)alloca(dirlen + 2);
+    memcpy(path, dir, dirlen);
+    path[dirlen] = 0;
+    if (!dirlen)
+        strcpy(path, ".");
+
+    if (!dl)
+    {
+        char *cname = FileName::canonicalName(path);
+        const char *key = cname ? cname : path;
+        size_t keylen = strlen(key);
+        sv = dirs.lookup(key, keylen);
+        dl = sv ? (DirListing *)sv->ptrvalue : newListing(key, keylen);
+        paths.update(dir, dirlen)->ptrvalue = dl;
+        free(cname);
+        if (sv && !dl->fromfile)
+            return dl;
+    }
+
+    struct stat st;
+    numStats++;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        dl->exists = 0;
+        dl->fromfile = 0;
+        dl->names.setDim(0);
+        return dl;
+    }
+
+    if (dl->fromfile && dl->mtime == (long)st.st_mtime)
+    {   // The saved listing is still good
+        numReused++;
+        dl->exists = 1;
+        dl->fromfile = 0;
+        enterNames(dl);
+        return dl;
+    }
+
+    dl->names.setDim(0);
+    dl->mtime = st.st_mtime;
+    dl->exists = 0;
+    dl->fromfile = 0;
+
+    DIR *d = opendir(path);
+    if (d)
+    {
+        numListed++;
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL)
+        {
+            if (de->d_name[0] == '.' &&
+                (de->d_name[1] == 0 || (de->d_name[1] == '.' && de->d_name[2] == 0)))
+                continue;
+            dl->names.push(mem.strdup(de->d_name));
+        }
+        closedir(d);
+        dl->exists = 1;
+        enterNames(dl);
+    }
+    return dl;
+}
+
+/*********************************
+ * Determine if file dir/name exists, name may itself contain
+ * directory components.
+ * Returns:
+ *      !=0     file exists
+ */
+
+int ImportCache::exists(const char *dir, const char *name)
+{
+    double starttime = now();
+    numLookups++;
+    initialize();
+
+    char *n = FileName::combine(dir, name);
+    const char *base = strrchr(n, '/');
+    size_t dirlen = base ? (base == n ? 1 : base - n) : 0;  // keep "/" for the root
+    base = base ? base + 1 : n;
+
+    int result = 0;
+    DirListing *dl = getListing(n, dirlen);
+    if (dl->exists)
+    {
+        OutBuffer buf;
+        fileKey(&buf, dl->path, strlen(dl->path), base);
+        result = files.lookup((char *)buf.data, buf.offset) != NULL;
+    }
+    if (n != name)
+        mem.free(n);
+
+    lookupTime += now() - starttime;
+    return result;
+}
+
+/*********************************
+ * Read in the directory listings saved by a previous compilation.
+ * The file format is:
+ *      D mtime path
+ *      F name
+ *      F name
+ *      ...
+ * Listings are only used if the mtime of the directory still matches.
+ * A missing or malformed file is silently ignored.
+ */
+
+void ImportCache::load(const char *filename)
+{
+    initialize();
+
+    File f((char *)filename);
+    if (f.read())
+        return;
+
+    char *p = (char *)f.buffer;
+    char *end = p + f.len;
+    DirListing *dl = NULL;
+    while (p < end)
+    {
+        char *line = p;
+        while (p < end && *p != '\n')
+            p++;
+        if (p == end)
+            break;              // truncated
+        *p++ = 0;
+
+        if (line[0] == 'D' && line[1] == ' ')
+        {
+            char *q;
+            long mtime = strtol(line + 2, &q, 10);
+            if (*q != ' ')
+                break;
+            q++;
+            size_t len = strlen(q);
+            if (dirs.lookup(q, len))
+            {   dl = NULL;
+                continue;
+            }
+            dl = newListing(q, len);
+            dl->mtime = mtime;
+            dl->fromfile = 1;
+        }
+        else if (line[0] == 'F' && line[1] == ' ' && dl)
+            dl->names.push(mem.strdup(line + 2));
+        else
+            break;
+    }
+}
+
+/*********************************
+ * Write out the directory listings. Directories modified in the last
+ * couple of seconds are left out, their mtime may not change on
+ * the next modification, as are those without an absolute path.
+ */
+
+void ImportCache::save(const char *filename)
+{
+    if (!initialized)
+        return;
+
+    long limit = (long)time(NULL) - 2;
+    OutBuffer buf;
+    for (size_t i = 0; i < listings.dim; i++)
+    {   DirListing *dl = listings[i];
+
+        if (!(dl->exists || dl->fromfile) || dl->mtime >= limit ||
+            dl->path[0] != '/')
+            continue;
+        buf.printf("D %ld %s\n", dl->mtime, dl->path);
+        for (size_t j = 0; j < dl->names.dim; j++)
+            buf.printf("F %s\n", dl->names[j]);
+    }
+
+    /* Write to a temporary and rename it, so concurrent compilations
+     * never see a partially written cache.
+     */
+    OutBuffer tmpname;
+    tmpname.printf("%s.%ld.tmp", filename, (long)getpid());
+    tmpname.writeByte(0);
+
+    File f((char *)tmpname.data);
+    f.setbuffer(buf.data, buf.offset);
+    f.ref = 1;
+    if (f.write() == 0)
+    {
+        if (rename((char *)tmpname.data, filename) != 0)
+            remove((char *)tmpname.data);
+    }
+}
+
+/*********************************
+ * Forget which files exist, the listings are checked again against
+ * the modification time of their directory when next used.
+ * For compilations done one after another by the same process.
+ */
+
+void ImportCache::reset()
+{
+    if (!initialized)
+        return;
+
+    files.reset(1009);
+    paths.reset();              // the current directory may have changed
+    long limit = (long)time(NULL) - 2;
+    for (size_t i = 0; i < listings.dim; i++)
+    {   DirListing *dl = listings[i];
+
+        if (dl->mtime >= limit)
+            dl->mtime = 0;      // may have changed in the same second
+        dl->fromfile = 1;
+    }
+}
+
+#endif
+
+void ImportCache::printStats()
+{
+    fprintf(stdmsg, "importcache lookups %u, stats %u, listed %u, reused %u, time %.3fs\n",
+        numLookups, numStats, numListed, numReused, lookupTime);
+}
@@ -0,0 +1,43 @@
+// impcache.h -- D frontend for GCC.
+// Copyright (C) 2012 Free Software Foundation, Inc.
+
+// GCC is free software; you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3, or (at your option) any later
+// version.
+
+// GCC is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with GCC; see the file COPYING3.  If not see
+// <http://www.gnu.org/licenses/>.
+
+#ifndef DMD_IMPCACHE_H
+#define DMD_IMPCACHE_H
+
+#ifdef __DMC__
+#pragma once
+#endif /* __DMC__ */
+
+/* Cache of the contents of the directories searched for imports,
+ * so looking for a module along global.path does a directory listing
+ * per directory instead of a stat() per directory per module.
+ * The listings can be saved to a file and reused by later compilations
+ * for as long as the directory modification times don't change.
+ */
+
+struct ImportCache
+{
+    static int exists(const char *dir, const char *name);
+
+    static void load(const char *filename);
+    static void save(const char *filename);
+    static void reset();
+
+    static void printStats();
+};
+
+#endif /* DMD_IMPCACHE_H */
@@ -36,8 +36,31 @@ struct InlineCostState
     int hasthis;
     int hdrscan;    // !=0 if inline scan for 'header' content
     FuncDeclaration *fd;
+#ifdef IN_GCC
+    VarDeclaration *vdg;        // delegate parameter of an opApply
+    int dgrefs;                 // number of uses of vdg
+    int dgcalls;                // number of those that call it
+#endif
 };
 
+#ifdef IN_GCC
+/* The cost at which functions are too costly to inline is set by
+ * -ffrontend-inline-limit=, and -ffrontend-inline-apply-limit= for
+ * opApply.  COST_MAX, what can't be inlined at all, is above any limit.
+ */
+const int COST_MAX = 0x1000;
+const int STATEMENT_COST = 0x10000;
+const int STATEMENT_COST_MAX = 250 * 0x10000;
+
+static int costLimit = 250;
+
+static int limitCost(unsigned limit)
+{
+    return limit < COST_MAX ? limit : COST_MAX - 1;
+}
+
+bool tooCostly(int cost) { return ((cost & (STATEMENT_COST - 1)) >= costLimit); }
+#else
 const int COST_MAX = 250;
 const int STATEMENT_COST = 0x1000;
 const int STATEMENT_COST_MAX = 250 * 0x1000;
@@ -47,6 +70,7 @@ const int STATEMENT_COST_MAX = 250 * 0x1000;
 //static assert(STATEMENT_COST > COST_MAX);
 
 bool tooCostly(int cost) { return ((cost & (STATEMENT_COST - 1)) >= COST_MAX); }
+#endif
 
 int expressionInlineCost(Expression *e, InlineCostState *ics);
 
@@ -83,6 +107,7 @@ int CompoundStatement::inlineCost(InlineCostState *ics)
 int UnrolledLoopStatement::inlineCost(InlineCostState *ics)
 {   int cost = 0;
 
+    ics->nested += 1;
     for (size_t i = 0; i < statements->dim; i++)
     {   Statement *s = (*statements)[i];
         if (s)
@@ -92,6 +117,7 @@ int UnrolledLoopStatement::inlineCost(InlineCostState *ics)
                 break;
         }
     }
+    ics->nested -= 1;
     return cost;
 }
 
@@ -107,7 +133,12 @@ int IfStatement::inlineCost(InlineCostState *ics)
     /* Can't declare variables inside ?: expressions, so
      * we cannot inline if a variable is declared.
      */
+#ifdef IN_GCC
+    // An opApply is only inlined as statements.
+    if (arg && !ics->vdg)
+#else
     if (arg)
+#endif
         return COST_MAX;
 
     cost = expressionInlineCost(condition, ics);
@@ -144,7 +175,12 @@ int IfStatement::inlineCost(InlineCostState *ics)
 int ReturnStatement::inlineCost(InlineCostState *ics)
 {
     // Can't handle return statements nested in if's
+#ifdef IN_GCC
+    // unless they can jump to the end of an opApply
+    if (ics->nested && !ics->vdg)
+#else
     if (ics->nested)
+#endif
         return COST_MAX;
     return expressionInlineCost(exp, ics);
 }
@@ -166,12 +202,27 @@ int ForStatement::inlineCost(InlineCostState *ics)
         cost += expressionInlineCost(condition, ics);
     if (increment)
         cost += expressionInlineCost(increment, ics);
+    ics->nested += 1;
     if (body)
         cost += body->inlineCost(ics);
+    ics->nested -= 1;
     //printf("ForStatement: inlineCost = %d\n", cost);
     return cost;
 }
 
+#ifdef IN_GCC
+int BreakStatement::inlineCost(InlineCostState *ics)
+{
+    // Only inside the loops of an opApply
+    return (ident || !ics->vdg) ? COST_MAX : 1;
+}
+
+int ContinueStatement::inlineCost(InlineCostState *ics)
+{
+    return (ident || !ics->vdg) ? COST_MAX : 1;
+}
+#endif
+
 
 /* -------------------------- */
 
@@ -185,6 +236,12 @@ int lambdaInlineCost(Expression *e, void *param)
 {
     ICS2 *ics2 = (ICS2 *)param;
     ics2->cost += e->inlineCost3(ics2->ics);
+#ifdef IN_GCC
+    // Taking the address of the delegate is not calling it.
+    if (ics2->ics->vdg && e->op == TOKsymoff &&
+        ((SymOffExp *)e)->var == ics2->ics->vdg)
+        ics2->ics->dgrefs++;
+#endif
     return (ics2->cost >= COST_MAX);
 }
 
@@ -208,6 +265,10 @@ int Expression::inlineCost3(InlineCostState *ics)
 int VarExp::inlineCost3(InlineCostState *ics)
 {
     //printf("VarExp::inlineCost3() %s\n", toChars());
+#ifdef IN_GCC
+    if (ics->vdg && var == ics->vdg)
+        ics->dgrefs++;
+#endif
     Type *tb = type->toBasetype();
     if (tb->ty == Tstruct)
     {
@@ -332,6 +393,10 @@ int CallExp::inlineCost3(InlineCostState *ics)
     if (e1->op == TOKdotvar && ((DotVarExp *)e1)->e1->op == TOKsuper)
         return COST_MAX;
 
+#ifdef IN_GCC
+    if (ics->vdg && e1->op == TOKvar && ((VarExp *)e1)->var == ics->vdg)
+        ics->dgcalls++;
+#endif
     return 1;
 }
 
@@ -351,6 +416,11 @@ struct InlineDoState
     Dsymbols to;        // parallel array of new Dsymbols
     Dsymbol *parent;    // new parent
     FuncDeclaration *fd; // function being inlined (old parent)
+#ifdef IN_GCC
+    VarDeclaration *vdg;        // delegate parameter of an opApply
+    FuncDeclaration *fdg;       // function literal called in its place
+    LabelDsymbol *lreturn;      // end of the opApply, where returns go
+#endif
 };
 
 /* -------------------------------------------------------------------- */
@@ -428,19 +498,35 @@ Statement *ScopeStatement::doInlineStatement(InlineDoState *ids)
 
 Statement *IfStatement::doInlineStatement(InlineDoState *ids)
 {
+#ifdef IN_GCC
+    // The declaration of arg is part of the condition.
+    assert(!arg || ids->vdg);
+#else
     assert(!arg);
+#endif
 
     Expression *condition = this->condition ? this->condition->doInline(ids) : NULL;
     Statement *ifbody = this->ifbody ? this->ifbody->doInlineStatement(ids) : NULL;
     Statement *elsebody = this->elsebody ? this->elsebody->doInlineStatement(ids) : NULL;
 
-    return new IfStatement(loc, arg, condition, ifbody, elsebody);
+    return new IfStatement(loc, NULL, condition, ifbody, elsebody);
 }
 
 Statement *ReturnStatement::doInlineStatement(InlineDoState *ids)
 {
     //printf("ReturnStatement::doInlineStatement() '%s'\n", exp ? exp->toChars() : "");
-    return new ReturnStatement(loc, exp ? exp->doInline(ids) : NULL);
+    /* Only the last statement returns, unless this is an opApply,
+     * and it must not return from the function inlined into.
+     */
+    Statement *s = new ExpStatement(loc, exp ? exp->doInline(ids) : NULL);
+#ifdef IN_GCC
+    if (ids->lreturn)
+    {   GotoStatement *gs = new GotoStatement(loc, ids->lreturn->ident);
+        gs->label = ids->lreturn;
+        s = new CompoundStatement(loc, s, gs);
+    }
+#endif
+    return s;
 }
 
 #if DMDV2
@@ -460,6 +546,18 @@ Statement *ForStatement::doInlineStatement(InlineDoState *ids)
     return new ForStatement(loc, init, condition, increment, body);
 }
 
+#ifdef IN_GCC
+Statement *BreakStatement::doInlineStatement(InlineDoState *ids)
+{
+    return new BreakStatement(loc, NULL);
+}
+
+Statement *ContinueStatement::doInlineStatement(InlineDoState *ids)
+{
+    return new ContinueStatement(loc, NULL);
+}
+#endif
+
 /* -------------------------------------------------------------------- */
 
 Expression *Statement::doInline(InlineDoState *ids)
@@ -780,6 +878,16 @@ Expression *CallExp::doInline(InlineDoState *ids)
     CallExp *ce;
 
     ce = (CallExp *)copy();
+#ifdef IN_GCC
+    if (ids->vdg && e1->op == TOKvar && ((VarExp *)e1)->var == ids->vdg)
+    {   // Call the function literal given to the opApply directly
+        VarExp *ve = new VarExp(e1->loc, ids->fdg);
+        ve->type = ids->fdg->type;
+        ce->e1 = ve;
+        ce->f = ids->fdg;
+    }
+    else
+#endif
     ce->e1 = e1->doInline(ids);
     ce->arguments = arrayExpressiondoInline(arguments, ids);
     return ce;
@@ -969,6 +1077,35 @@ Statement *ExpStatement::inlineScan(InlineScanState *iss)
                     return s;
                 }
             }
+#ifdef IN_GCC
+            /* See if this is the opApply call a foreach statement
+             * is rewritten to, and the body can be called directly.
+             */
+            else if (ce->e1->op == TOKdotvar &&
+                     ce->arguments && ce->arguments->dim == 1)
+            {
+                DotVarExp *dve = (DotVarExp *)ce->e1;
+                FuncDeclaration *fd = dve->var->isFuncDeclaration();
+                Expression *arg = (*ce->arguments)[0];
+
+                while (arg->op == TOKcast)
+                    arg = ((CastExp *)arg)->e1;
+                FuncLiteralDeclaration *fdg = arg->op == TOKfunction
+                        ? ((FuncExp *)arg)->fd : NULL;
+
+                if (fd && fd != iss->fd &&
+                    (fd->ident == Id::apply || fd->ident == Id::applyReverse) &&
+                    fdg && fdg->fes && fdg->tok == TOKdelegate && fdg->fbody &&
+                    fdg->toParent2() == iss->fd &&
+                    // 'this' of a struct is a reference to the aggregate
+                    (dve->e1->type->toBasetype()->ty != Tstruct ||
+                     dve->e1->isLvalue()) &&
+                    fd->canInlineApply(fdg))
+                {
+                    return fd->expandApply(iss, dve->e1, fdg);
+                }
+            }
+#endif
         }
     }
     return this;
@@ -1521,6 +1658,9 @@ int FuncDeclaration::canInline(int hasthis, int hdrscan, int statementsToo)
     }
 #endif
 
+#ifdef IN_GCC
+    costLimit = limitCost(global.params.inlineLimit);
+#endif
     memset(&ics, 0, sizeof(ics));
     ics.hasthis = hasthis;
     ics.fd = this;
@@ -1547,6 +1687,9 @@ int FuncDeclaration::canInline(int hasthis, int hdrscan, int statementsToo)
         if (inlineStatusExp == ILSuninitialized)
         {
             // Need to redo cost computation, as some statements or expressions have been inlined
+#ifdef IN_GCC
+            costLimit = limitCost(global.params.inlineLimit);
+#endif
             memset(&ics, 0, sizeof(ics));
             ics.hasthis = hasthis;
             ics.fd = this;
@@ -1584,6 +1727,171 @@ Lno:
     return 0;
 }
 
+#ifdef IN_GCC
+/*****************************
+ * Return !=0 if this function, compiled in another object file, is small
+ * enough for its body to be given to the backend to inline into callers.
+ * Unlike canInline(), the result doesn't depend on the caller, and the
+ * body is not inline scanned, as the frontend inliner doesn't run.
+ */
+
+int FuncDeclaration::canInlineImport()
+{
+    if (!fbody || semanticRun < PASSsemantic3done ||
+        isNested() || frequire || fensure ||
+        ident == Id::ensure || ident == Id::require ||
+        isSynchronized() ||
+        hasNestedFrameRefs() || closureVars.dim ||
+        (isVirtual() && !isFinal()))
+        return 0;
+
+    TypeFunction *tf = (TypeFunction *)type;
+    if (tf->varargs == 1)
+        return 0;
+
+    InlineCostState ics;
+    memset(&ics, 0, sizeof(ics));
+    ics.hasthis = 1;
+    ics.fd = this;
+    costLimit = limitCost(global.params.inlineLimit);
+    return !tooCostly(fbody->inlineCost(&ics));
+}
+
+/*****************************
+ * Return !=0 if the delegate types of t1 and t2 are called the same way.
+ */
+
+static int sameCall(TypeFunction *t1, TypeFunction *t2)
+{
+    if (t1->varargs || t2->varargs || t1->isref != t2->isref ||
+        t1->linkage != t2->linkage || !t1->next->equals(t2->next))
+        return 0;
+
+    size_t dim = Parameter::dim(t1->parameters);
+    if (dim != Parameter::dim(t2->parameters))
+        return 0;
+    for (size_t i = 0; i < dim; i++)
+    {   Parameter *p1 = Parameter::getNth(t1->parameters, i);
+        Parameter *p2 = Parameter::getNth(t2->parameters, i);
+
+        if (!p1->type->equals(p2->type) ||
+            (p1->storageClass & (STCout | STCref | STClazy)) !=
+            (p2->storageClass & (STCout | STCref | STClazy)))
+            return 0;
+    }
+    return 1;
+}
+
+/*****************************
+ * Return !=0 if this opApply can be inlined into a foreach statement
+ * whose body is the function literal fdg.  Its delegate parameter must
+ * only ever be called, so that fdg can be called directly instead.
+ */
+
+int FuncDeclaration::canInlineApply(FuncLiteralDeclaration *fdg)
+{
+    if (inlineNest || semanticRun < PASSsemantic3done ||
+        !fbody || isNested() || frequire || fensure ||
+        isSynchronized() || isImportedSymbol() ||
+        hasNestedFrameRefs() || closureVars.dim ||
+        (isVirtual() && !isFinal()))
+        return 0;
+
+    // Members of nested aggregates reach into another frame.
+    AggregateDeclaration *ad = isThis();
+    if (!ad || ad->isNested())
+        return 0;
+
+    TypeFunction *tf = (TypeFunction *)type;
+    if (tf->varargs || tf->isref || !parameters || parameters->dim != 1)
+        return 0;
+
+    VarDeclaration *vdg = (*parameters)[0];
+    Type *tdg = vdg->type->toBasetype();
+    if ((vdg->storage_class & (STCout | STCref | STClazy)) ||
+        tdg->ty != Tdelegate ||
+        !sameCall((TypeFunction *)tdg->nextOf(), (TypeFunction *)fdg->type))
+        return 0;
+
+    InlineCostState ics;
+    memset(&ics, 0, sizeof(ics));
+    ics.hasthis = 1;
+    ics.fd = this;
+    ics.vdg = vdg;
+    costLimit = limitCost(global.params.inlineApplyLimit);
+    int cost = fbody->inlineCost(&ics);
+    return !tooCostly(cost) && ics.dgrefs == ics.dgcalls;
+}
+
+/*****************************
+ * Expand this opApply in place of a call to it, with the object ethis
+ * and the function literal fdg as the delegate.  The result of the
+ * opApply is dropped, as foreach does when the loop body can only break
+ * or continue.
+ */
+
+Statement *FuncDeclaration::expandApply(InlineScanState *iss, Expression *ethis, FuncLiteralDeclaration *fdg)
+{
+    InlineDoState ids;
+    Statements *as = new Statements();
+    DeclarationExp *de;
+
+#if LOG || CANINLINE_LOG
+    printf("FuncDeclaration::expandApply('%s')\n", toChars());
+#endif
+
+    memset(&ids, 0, sizeof(ids));
+    ids.parent = iss->fd;
+    ids.fd = this;
+    ids.vdg = (*parameters)[0];
+    ids.fdg = fdg;
+
+    // Set up vthis, as expandInline() does
+    if (ethis->type->ty == Tpointer)
+    {   Type *t = ethis->type->nextOf();
+        ethis = new PtrExp(ethis->loc, ethis);
+        ethis->type = t;
+    }
+    ExpInitializer *ei = new ExpInitializer(ethis->loc, ethis);
+    VarDeclaration *vthis = new VarDeclaration(ethis->loc, ethis->type, Id::This, ei);
+    vthis->storage_class = (ethis->type->ty != Tclass) ? STCref : STCin;
+    vthis->linkage = LINKd;
+    vthis->parent = iss->fd;
+
+    VarExp *ve = new VarExp(vthis->loc, vthis);
+    ve->type = vthis->type;
+    ei->exp = new AssignExp(vthis->loc, ve, ethis);
+    ei->exp->type = ve->type;
+    if (ethis->type->ty != Tclass)
+        ei->exp->op = TOKconstruct;
+    ids.vthis = vthis;
+
+    de = new DeclarationExp(0, vthis);
+    de->type = Type::tvoid;
+    as->push(new ExpStatement(0, de));
+
+    // The function literal is no longer made into a delegate,
+    // but still has to be output.
+    de = new DeclarationExp(0, fdg);
+    de->type = Type::tvoid;
+    as->push(new ExpStatement(0, de));
+
+    // Where return statements go
+    Identifier *id = Identifier::generateId("__applyend");
+    LabelStatement *ls = new LabelStatement(0, id, NULL);
+    ids.lreturn = iss->fd->searchLabel(id);
+    ids.lreturn->statement = ls;
+
+    inlineNest++;
+    as->push(fbody->doInlineStatement(&ids));
+    inlineNest--;
+    as->push(ls);
+
+    iss->fd->inlineStatusExp = ILSuninitialized;
+    return new ScopeStatement(0, new CompoundStatement(0, as));
+}
+#endif
+
 Expression *FuncDeclaration::expandInline(InlineScanState *iss, Expression *ethis, Expressions *arguments, Statement **ps)
 {
     InlineDoState ids;
@@ -27,6 +27,8 @@
 #include "attrib.h" // for AttribDeclaration
 
 #include "template.h"
+#include "ctfevm.h"
+#include "ctfeprof.h"
 
 #ifdef IN_GCC
 #include "d-dmd-gcc.h"
@@ -36,9 +38,6 @@
 #define LOGASSIGN 0
 #define SHOWPERFORMANCE 0
 
-// Maximum allowable recursive function calls in CTFE
-#define CTFE_RECURSION_LIMIT 1000
-
 // The values of all CTFE variables.
 struct CtfeStack
 {
@@ -207,12 +206,15 @@ void printCtfePerformanceStats()
 #if SHOWPERFORMANCE
     printf("        ---- CTFE Performance ----\n");
     printf("max call depth = %d\tmax stack = %d\n", CtfeStatus::maxCallDepth, ctfeStack.maxStackUsage());
-    printf("array allocs = %d\tassignments = %d\n\n", CtfeStatus::numArrayAllocs, CtfeStatus::numAssignments);
+    printf("array allocs = %d\tassignments = %d\n", CtfeStatus::numArrayAllocs, CtfeStatus::numAssignments);
+    CtfeVM::printStats();
+    printf("\n");
 #endif
 }
 
 
 Expression * resolveReferences(Expression *e, Expression *thisval);
+Expression *resolveSlice(Expression *e);
 Expression *getVarExp(Loc loc, InterState *istate, Declaration *d, CtfeGoal goal);
 VarDeclaration *findParentVar(Expression *e, Expression *thisval);
 bool needToCopyLiteral(Expression *expr);
@@ -491,6 +493,228 @@ void showCtfeExpr(Expression *e, int level = 0)
     }
 }
 
+/******************************** Memoization ***************************/
+
+/* Calls to strongly pure functions with the same argument values give
+ * the same result, so the results are remembered keyed on the function
+ * and the argument literals.
+ */
+
+// Maximum number of remembered results
+#define CTFE_MEMO_LIMIT 8192
+// Calls whose arguments have more elements than this are not remembered
+#define CTFE_MEMO_MAXSIZE 4096
+
+struct CtfeMemo
+{
+    CtfeMemo *next;             // next in hash chain
+    hash_t hash;
+    FuncDeclaration *fd;
+    Expressions *args;
+    Expression *result;
+};
+
+static CtfeMemo *memoTable[4096];
+
+/* Compute a structural hash of literal e, adding its number of elements
+ * to *psize.
+ * Returns:
+ *      0       e is not a literal that can be remembered
+ */
+static hash_t memoHash(Expression *e, size_t *psize)
+{
+    hash_t h = e->op;
+    Expressions *elements = NULL;
+    Expressions *values = NULL;
+
+    ++*psize;
+    switch (e->op)
+    {
+        case TOKint64:
+            h = h * 37 + (hash_t)e->toInteger();
+            break;
+
+        case TOKnull:
+            break;
+
+        case TOKstring:
+        {   StringExp *se = (StringExp *)e;
+            *psize += se->len;
+            h = h * 37 + String::calcHash((const char *)se->string, se->len * se->sz);
+            break;
+        }
+
+        case TOKarrayliteral:
+            elements = ((ArrayLiteralExp *)e)->elements;
+            break;
+
+        case TOKassocarrayliteral:
+            elements = ((AssocArrayLiteralExp *)e)->keys;
+            values = ((AssocArrayLiteralExp *)e)->values;
+            break;
+
+        case TOKstructliteral:
+            h = h * 37 + (hash_t)((StructLiteralExp *)e)->sd;
+            elements = ((StructLiteralExp *)e)->elements;
+            break;
+
+        default:
+            return 0;
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {   Expressions *exps = pass ? values : elements;
+        for (size_t i = 0; exps && i < exps->dim; i++)
+        {   Expression *x = exps->tdata()[i];
+            hash_t hx = 0;
+            if (x && !(hx = memoHash(x, psize)))
+                return 0;
+            h = h * 37 + hx;
+        }
+    }
+    if (*psize > CTFE_MEMO_MAXSIZE)
+        return 0;
+    return h ? h : 1;
+}
+
+static int memoEquals(Expressions *a1, Expressions *a2);
+
+/* Return !=0 if literals e1 and e2 are structurally the same.
+ */
+static int memoEquals(Expression *e1, Expression *e2)
+{
+    if (e1->op != e2->op || !e1->type->equals(e2->type))
+        return 0;
+    switch (e1->op)
+    {
+        case TOKint64:
+            return e1->toInteger() == e2->toInteger();
+
+        case TOKnull:
+            return 1;
+
+        case TOKstring:
+        {   StringExp *se1 = (StringExp *)e1;
+            StringExp *se2 = (StringExp *)e2;
+            return se1->len == se2->len && se1->sz == se2->sz &&
+                memcmp(se1->string, se2->string, se1->len * se1->sz) == 0;
+        }
+
+        case TOKarrayliteral:
+            return memoEquals(((ArrayLiteralExp *)e1)->elements,
+                              ((ArrayLiteralExp *)e2)->elements);
+
+        case TOKassocarrayliteral:
+            return memoEquals(((AssocArrayLiteralExp *)e1)->keys,
+                              ((AssocArrayLiteralExp *)e2)->keys) &&
+                   memoEquals(((AssocArrayLiteralExp *)e1)->values,
+                              ((AssocArrayLiteralExp *)e2)->values);
+
+        case TOKstructliteral:
+            return ((StructLiteralExp *)e1)->sd == ((StructLiteralExp *)e2)->sd &&
+                   memoEquals(((StructLiteralExp *)e1)->elements,
+                              ((StructLiteralExp *)e2)->elements);
+
+        default:
+            return 0;
+    }
+}
+
+static int memoEquals(Expressions *a1, Expressions *a2)
+{
+    size_t dim1 = a1 ? a1->dim : 0;
+    size_t dim2 = a2 ? a2->dim : 0;
+    if (dim1 != dim2)
+        return 0;
+    for (size_t i = 0; i < dim1; i++)
+    {   Expression *x1 = a1->tdata()[i];
+        Expression *x2 = a2->tdata()[i];
+        if (x1 != x2 && (!x1 || !x2 || !memoEquals(x1, x2)))
+            return 0;
+    }
+    return 1;
+}
+
+/* Resolve slices so e can be hashed and compared.
+ */
+static Expression *memoValue(Expression *e)
+{
+    if (e->op == TOKslice)
+    {   e = resolveSlice(e);
+        if (e == EXP_CANT_INTERPRET)
+            return NULL;
+    }
+    return e;
+}
+
+/*************************************
+ * Compute the memo hash of the call fd(eargs), and put the argument
+ * values to compare in *memoargs.
+ * Returns:
+ *      0       the call can't be remembered
+ */
+static hash_t ctfeMemoHash(FuncDeclaration *fd, Expressions *eargs, Expressions *memoargs)
+{
+    TypeFunction *tf = (TypeFunction *)fd->type->toBasetype();
+    if (tf->varargs || fd->isNested() || fd->needThis() ||
+        fd->isPure() != PUREstrong)
+        return 0;
+
+    hash_t h = (hash_t)fd;
+    size_t size = 0;
+    memoargs->setDim(eargs->dim);
+    for (size_t i = 0; i < eargs->dim; i++)
+    {   Parameter *arg = Parameter::getNth(tf->parameters, i);
+        if (arg->storageClass & (STCout | STCref | STClazy))
+            return 0;
+        Expression *e = memoValue(eargs->tdata()[i]);
+        hash_t he = e ? memoHash(e, &size) : 0;
+        if (!he)
+            return 0;
+        memoargs->tdata()[i] = e;
+        h = h * 37 + he;
+    }
+    return h ? h : 1;
+}
+
+static Expression *ctfeMemoLookup(FuncDeclaration *fd, hash_t hash, Expressions *memoargs)
+{
+    CtfeProfile::numMemoLookups++;
+    for (CtfeMemo *m = memoTable[hash % (sizeof(memoTable) / sizeof(memoTable[0]))]; m; m = m->next)
+    {
+        if (m->hash == hash && m->fd == fd && memoEquals(m->args, memoargs))
+        {
+            CtfeProfile::numMemoHits++;
+            // The caller may modify the result in place
+            return copyLiteral(m->result);
+        }
+    }
+    return NULL;
+}
+
+static void ctfeMemoInsert(FuncDeclaration *fd, hash_t hash, Expressions *memoargs, Expression *result)
+{
+    if (CtfeProfile::numMemoized >= CTFE_MEMO_LIMIT)
+        return;
+    size_t size = 0;
+    result = memoValue(result);
+    if (!result || !memoHash(result, &size))
+        return;
+
+    CtfeMemo *m = new CtfeMemo();
+    m->hash = hash;
+    m->fd = fd;
+    m->args = new Expressions();
+    m->args->setDim(memoargs->dim);
+    for (size_t i = 0; i < memoargs->dim; i++)
+        m->args->tdata()[i] = copyLiteral(memoargs->tdata()[i]);
+    m->result = copyLiteral(result);
+
+    CtfeMemo **pm = &memoTable[hash % (sizeof(memoTable) / sizeof(memoTable[0]))];
+    m->next = *pm;
+    *pm = m;
+    CtfeProfile::numMemoized++;
+}
+
 /*************************************
  * Attempt to interpret a function given the arguments.
  * Input:
@@ -507,6 +731,8 @@ Expression *FuncDeclaration::interpret(InterState *istate, Expressions *argument
 #if LOG
     printf("\n********\nFuncDeclaration::interpret(istate = %p) %s\n", istate, toChars());
 #endif
+    Loc callsite = CtfeProfile::callsite;       // evaluating the arguments changes it
+    CtfeProfile::numCalls++;
     if (semanticRun == PASSsemantic3)
         return EXP_CANT_INTERPRET;
 
@@ -571,6 +797,7 @@ Expression *FuncDeclaration::interpret(InterState *istate, Expressions *argument
             return EXP_CANT_INTERPRET;
     }
     static int evaluatingArgs = 0;
+    Expressions eargs;
     if (arguments)
     {
         dim = arguments->dim;
@@ -580,7 +807,6 @@ Expression *FuncDeclaration::interpret(InterState *istate, Expressions *argument
         /* Evaluate all the arguments to the function,
          * store the results in eargs[]
          */
-        Expressions eargs;
         eargs.setDim(dim);
         for (size_t i = 0; i < dim; i++)
         {   Expression *earg = arguments->tdata()[i];
@@ -677,6 +903,42 @@ Expression *FuncDeclaration::interpret(InterState *istate, Expressions *argument
         }
     }
 
+    if (CtfeProfile::enabled)
+        CtfeProfile::enter(this, callsite);
+
+    Expressions memoargs;
+    hash_t memohash = thisarg ? 0 : ctfeMemoHash(this, &eargs, &memoargs);
+    if (memohash)
+    {
+        Expression *e = ctfeMemoLookup(this, memohash, &memoargs);
+        if (e)
+        {
+            if (CtfeProfile::enabled)
+                CtfeProfile::leave(ctfeStack.stackPointer());
+            ctfeStack.endFrame(istatex.framepointer);
+            if (!istate && !evaluatingArgs)
+                e = scrubReturnValue(loc, e);
+            return e;
+        }
+    }
+
+    /* Functions on integral values are run by the bytecode VM,
+     * which returns NULL for anything it can't do.
+     */
+    if (!thisarg)
+    {
+        Expression *e = CtfeVM::run(this, &eargs, CtfeStatus::callDepth);
+        if (e)
+        {
+            if (CtfeProfile::enabled)
+                CtfeProfile::leave(ctfeStack.stackPointer());
+            ctfeStack.endFrame(istatex.framepointer);
+            if (memohash && e != EXP_VOID_INTERPRET)
+                ctfeMemoInsert(this, memohash, &memoargs, e);
+            return e;
+        }
+    }
+
     if (vresult)
         ctfeStack.push(vresult);
 
@@ -722,6 +984,9 @@ Expression *FuncDeclaration::interpret(InterState *istate, Expressions *argument
     // Leave the function
     --CtfeStatus::callDepth;
 
+    if (CtfeProfile::enabled)
+        CtfeProfile::leave(ctfeStack.stackPointer());
+
     ctfeStack.endFrame(istatex.framepointer);
 
     // If fell off the end of a void function, return void
@@ -741,6 +1006,9 @@ Expression *FuncDeclaration::interpret(InterState *istate, Expressions *argument
         return EXP_CANT_INTERPRET;
     }
 
+    if (memohash)
+        ctfeMemoInsert(this, memohash, &memoargs, e);
+
     // If we're about to leave CTFE, make sure we don't crash the
     // compiler by returning a CTFE-internal expression.
     if (!istate && !evaluatingArgs)
@@ -4937,6 +5205,7 @@ Expression *CallExp::interpret(InterState *istate, CtfeGoal goal)
             " because it has no available source code", fd->toChars());
         return EXP_CANT_INTERPRET;
     }
+    CtfeProfile::callsite = loc;
     eresult = fd->interpret(istate, arguments, pthis);
     if (eresult == EXP_CANT_INTERPRET)
     {   // Print a stack trace.
@@ -6131,6 +6400,7 @@ Expression *interpret_aaApply(InterState *istate, Expression *aa, Expression *de
         args.tdata()[numParams - 1] = evalue;
         if (numParams == 2) args.tdata()[0] = ekey;
 
+        CtfeProfile::callsite = deleg->loc;
         eresult = fd->interpret(istate, &args, pthis);
         if (exceptionOrCantInterpret(eresult))
             return eresult;
@@ -6385,6 +6655,7 @@ Expression *foreachApplyUtf(InterState *istate, Expression *str, Expression *del
 
             args.tdata()[numParams - 1] = val;
 
+            CtfeProfile::callsite = deleg->loc;
             eresult = fd->interpret(istate, &args, pthis);
             if (exceptionOrCantInterpret(eresult))
                 return eresult;
@@ -29,6 +29,7 @@
 #include "rmem.h"
 
 #include "stringtable.h"
+#include "async.h"
 
 #include "lexer.h"
 #include "utf.h"
@@ -102,7 +103,7 @@ void Token::print()
 
 const char *Token::toChars()
 {   const char *p;
-    static char buffer[3 + 3 * sizeof(float80value) + 1];
+    static THREAD_LOCAL char buffer[3 + 3 * sizeof(float80value) + 1];
 
     p = buffer;
     switch (value)
@@ -236,7 +237,7 @@ const char *Token::toChars()
 
 const char *Token::toChars(enum TOK value)
 {   const char *p;
-    static char buffer[3 + 3 * sizeof(value) + 1];
+    static THREAD_LOCAL char buffer[3 + 3 * sizeof(value) + 1];
 
     p = tochars[value];
     if (!p)
@@ -248,9 +249,8 @@ const char *Token::toChars(enum TOK value)
 
 /*************************** Lexer ********************************************/
 
-Token *Lexer::freelist = NULL;
+THREAD_LOCAL Token *Lexer::freelist = NULL;
 StringTable Lexer::stringtable;
-OutBuffer Lexer::stringbuffer;
 
 Lexer::Lexer(Module *mod,
         unsigned char *base, unsigned begoffset, unsigned endoffset,
@@ -327,26 +327,24 @@ void Lexer::error(Loc loc, const char *format, ...)
 
 void Lexer::verror(Loc loc, const char *format, va_list ap)
 {
+    MessageSink *sink = MessageSink::current();
     if (mod && !global.gag)
     {
-        char *p = loc.toChars();
-        if (*p)
-            fprintf(stdmsg, "%s: ", p);
-        mem.free(p);
+        vmessage(loc, "", format, ap);
 
-        vfprintf(stdmsg, format, ap);
-
-        fprintf(stdmsg, "\n");
-        fflush(stdmsg);
-
-        if (global.errors >= 20)        // moderate blizzard of cascading messages
+        if ((sink ? sink->errors : global.errors) >= 20)        // moderate blizzard of cascading messages
             fatal();
     }
+    else if (sink)
+        sink->gaggedErrors++;
     else
     {
         global.gaggedErrors++;
     }
-    global.errors++;
+    if (sink)
+        sink->errors++;
+    else
+        global.errors++;
 }
 
 TOK Lexer::nextToken()
@@ -674,12 +672,7 @@ void Lexer::scan(Token *t)
                     break;
                 }
 
-                StringValue *sv = stringtable.update((char *)t->ptr, p - t->ptr);
-                Identifier *id = (Identifier *) sv->ptrvalue;
-                if (!id)
-                {   id = new Identifier(sv->lstring.string,TOKidentifier);
-                    sv->ptrvalue = id;
-                }
+                Identifier *id = idPool((char *)t->ptr, p - t->ptr);
                 t->ident = id;
                 t->value = (enum TOK) id->value;
                 anyToken = 1;
@@ -689,6 +682,7 @@ void Lexer::scan(Token *t)
                     static char time[8+1];
                     static char timestamp[24+1];
 
+                    AsyncJobs::lock();
                     if (!date[0])       // lazy evaluation
                     {   time_t t;
                         char *p;
@@ -700,6 +694,7 @@ void Lexer::scan(Token *t)
                         sprintf(time, "%.8s", p + 11);
                         sprintf(timestamp, "%.24s", p);
                     }
+                    AsyncJobs::unlock();
 
 #if DMDV1
                     if (mod && id == Id::FILE)
@@ -2920,7 +2915,13 @@ Loc Lexer::tokenLoc()
 
 Identifier *Lexer::idPool(const char *s)
 {
-    size_t len = strlen(s);
+    return idPool(s, strlen(s));
+}
+
+Identifier *Lexer::idPool(const char *s, size_t len)
+{
+    // stringtable is shared by all threads parsing in parallel
+    AsyncJobs::lock();
     StringValue *sv = stringtable.update(s, len);
     Identifier *id = (Identifier *) sv->ptrvalue;
     if (!id)
@@ -2928,6 +2929,7 @@ Identifier *Lexer::idPool(const char *s)
         id = new Identifier(sv->lstring.string, TOKidentifier);
         sv->ptrvalue = id;
     }
+    AsyncJobs::unlock();
     return id;
 }
 
@@ -2944,10 +2946,11 @@ Identifier *Lexer::uniqueId(const char *s, int num)
     return idPool(buffer);
 }
 
+THREAD_LOCAL int Lexer::uniqueNum = 0;
+
 Identifier *Lexer::uniqueId(const char *s)
 {
-    static int num;
-    return uniqueId(s, ++num);
+    return uniqueId(s, ++uniqueNum);
 }
 
 /****************************************
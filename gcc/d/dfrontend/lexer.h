@@ -262,8 +262,8 @@ struct Token
 struct Lexer
 {
     static StringTable stringtable;
-    static OutBuffer stringbuffer;
-    static Token *freelist;
+    OutBuffer stringbuffer;     // per Lexer, see -fparse-threads
+    static THREAD_LOCAL Token *freelist;      // per thread, see -fparse-threads
 
     Loc loc;                    // for error messages
 
@@ -282,6 +282,8 @@ struct Lexer
 
     static void initKeywords();
     static Identifier *idPool(const char *s);
+    static Identifier *idPool(const char *s, size_t len);
+    static THREAD_LOCAL int uniqueNum;        // last number used by uniqueId(), see -fparse-threads
     static Identifier *uniqueId(const char *s);
     static Identifier *uniqueId(const char *s, int num);
 
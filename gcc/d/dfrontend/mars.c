@@ -38,6 +38,9 @@
 #include "cond.h"
 #include "expression.h"
 #include "lexer.h"
+#include "template.h"
+#include "impcache.h"
+#include "ctfeprof.h"
 #ifndef IN_GCC
 #include "lib.h"
 #include "json.h"
@@ -219,32 +222,22 @@ void errorSupplemental(Loc loc, const char *format, ...)
 
 void verror(Loc loc, const char *format, va_list ap)
 {
+    MessageSink *sink = MessageSink::current();
     if (!global.gag)
     {
-        char *p = loc.toChars();
-
-        if (*p)
-            fprintf(stdmsg, "%s: ", p);
-        mem.free(p);
-
-        fprintf(stdmsg, "Error: ");
-#if _MSC_VER
-        // MS doesn't recognize %zu format
-        OutBuffer tmp;
-        tmp.vprintf(format, ap);
-        fprintf(stdmsg, "%s", tmp.toChars());
-#else
-        vfprintf(stdmsg, format, ap);
-#endif
-        fprintf(stdmsg, "\n");
-        fflush(stdmsg);
+        vmessage(loc, "Error: ", format, ap);
 //halt();
     }
+    else if (sink)
+        sink->gaggedErrors++;
     else
     {
         global.gaggedErrors++;
     }
-    global.errors++;
+    if (sink)
+        sink->errors++;
+    else
+        global.errors++;
 }
 
 // Doesn't increase error count, doesn't print "Error:".
@@ -252,17 +245,11 @@ void verrorSupplemental(Loc loc, const char *format, va_list ap)
 {
     if (!global.gag)
     {
-        fprintf(stdmsg, "%s:        ", loc.toChars());
-#if _MSC_VER
-        // MS doesn't recognize %zu format
-        OutBuffer tmp;
-        tmp.vprintf(format, ap);
-        fprintf(stdmsg, "%s", tmp.toChars());
-#else
-        vfprintf(stdmsg, format, ap);
-#endif
-        fprintf(stdmsg, "\n");
-        fflush(stdmsg);
+        OutBuffer header;
+        char *p = loc.toChars();
+        header.printf("%s:        ", p);
+        mem.free(p);
+        vmessage(Loc(), header.toChars(), format, ap);
     }
 }
 
@@ -270,37 +257,60 @@ void vwarning(Loc loc, const char *format, va_list ap)
 {
     if (global.params.warnings && !global.gag)
     {
-        char *p = loc.toChars();
+        MessageSink *sink = MessageSink::current();
 
 #ifdef IN_GCC
-        if (global.params.warnings == 1 && !global.warnings)
+        if (global.params.warnings == 1 && !global.warnings && !(sink && sink->warnings))
             fprintf(stdmsg, "cc1d: all warnings being treated as errors\n");
 #endif
 
-        if (*p)
-            fprintf(stdmsg, "%s: ", p);
-        mem.free(p);
-
-        fprintf(stdmsg, "Warning: ");
-#if _MSC_VER
-        // MS doesn't recognize %zu format
-        OutBuffer tmp;
-        tmp.vprintf(format, ap);
-        fprintf(stdmsg, "%s", tmp.toChars());
-#else
-        vfprintf(stdmsg, format, ap);
-#endif
-        fprintf(stdmsg, "\n");
-        fflush(stdmsg);
+        vmessage(loc, "Warning: ", format, ap);
 //halt();
         if (global.params.warnings == 1)
-            global.warnings++;  // warnings don't count if gagged
+        {   // warnings don't count if gagged
+            if (sink)
+                sink->warnings++;
+            else
+                global.warnings++;
+        }
+    }
+}
+
+/**************************************
+ * Print message prefixed with loc and header, either to stdmsg
+ * or to the MessageSink of the calling thread.
+ */
+
+void vmessage(Loc loc, const char *header, const char *format, va_list ap)
+{
+    OutBuffer tmp;
+    char *p = loc.toChars();
+
+    if (*p)
+        tmp.printf("%s: ", p);
+    mem.free(p);
+
+    tmp.writestring(header);
+    // MS doesn't recognize %zu format, so always go through OutBuffer
+    tmp.vprintf(format, ap);
+    tmp.writeByte('\n');
+
+    MessageSink *sink = MessageSink::current();
+    if (sink)
+        sink->buf->write(&tmp);
+    else
+    {
+        fwrite(tmp.data, 1, tmp.offset, stdmsg);
+        fflush(stdmsg);
     }
 }
 
 /***************************************
  * Call this after printing out fatal error messages to clean up and exit
  * the compiler.
+ * A job running in parallel with others is only stopped, the thread
+ * that ran the jobs calls fatal() again once the messages of the jobs
+ * before it have been printed.
  */
 
 void fatal()
@@ -308,9 +318,72 @@ void fatal()
 #if 0
     halt();
 #endif
+    MessageSink *sink = MessageSink::current();
+    if (sink && sink->stop)
+    {
+        sink->stopped = 1;
+        longjmp(*sink->stop, 1);
+    }
+    // Don't lose the messages explaining why
+    if (sink)
+        sink->flush();
     exit(EXIT_FAILURE);
 }
 
+/* ======================== MessageSink =============================== */
+
+static THREAD_LOCAL MessageSink *currentSink;
+
+MessageSink::MessageSink()
+{
+    buf = new OutBuffer();
+    errors = 0;
+    warnings = 0;
+    gaggedErrors = 0;
+    stopped = 0;
+    stop = NULL;
+}
+
+MessageSink::~MessageSink()
+{
+    delete buf;
+}
+
+/***************************************
+ * Print the collected messages and add the error counts to
+ * the global ones.  Must not be called while other threads are
+ * still reporting into the global counts.
+ */
+
+void MessageSink::flush()
+{
+    if (buf->offset)
+    {
+        fwrite(buf->data, 1, buf->offset, stdmsg);
+        fflush(stdmsg);
+        buf->reset();
+    }
+    global.errors += errors;
+    global.warnings += warnings;
+    global.gaggedErrors += gaggedErrors;
+    errors = warnings = gaggedErrors = 0;
+}
+
+MessageSink *MessageSink::current()
+{
+    return currentSink;
+}
+
+/***************************************
+ * Send messages from the calling thread to sink,
+ * or to stdmsg if sink is NULL.
+ */
+
+void MessageSink::setCurrent(MessageSink *sink)
+{
+    currentSink = sink;
+}
+
 /**************************************
  * Try to stop forgetting to remove the breakpoints from
  * release builds.
@@ -1344,6 +1417,11 @@ int tryMain(int argc, char *argv[])
             printf("semantic3 %s\n", m->toChars());
         m->semantic3();
     }
+    if (global.params.verbose)
+    {   TemplateStats::print();
+        ImportCache::printStats();
+        CtfeProfile::printStats();
+    }
     if (global.errors)
         fatal();
 
@@ -77,6 +77,7 @@ the target object file format:
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <stdarg.h>
+#include <setjmp.h>
 
 #ifdef __DMC__
 #ifdef DEBUG
@@ -227,6 +228,8 @@ struct Param
     OutBuffer *makeDeps;        // contents to be written to make deps file
     char makeDepsStyle;         // 0: include system header files
                                 // 1: ignore system header files
+    unsigned inlineLimit;       // cost at which functions are not inlined
+    unsigned inlineApplyLimit;  // same for opApply inlined into foreach
 #endif
 
     // Hidden debug switches
@@ -464,6 +467,38 @@ void util_progress();
 #define stdmsg stderr
 #endif
 
+/*** Thread local storage class ***/
+#ifndef THREAD_LOCAL
+#if _MSC_VER || __DMC__
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+#endif
+
+/* Messages and error counts reported by a thread running jobs in
+ * parallel are collected in a MessageSink, so the main thread can
+ * print them in a deterministic order once all the jobs are done.
+ */
+struct MessageSink
+{
+    OutBuffer *buf;
+    unsigned errors;
+    unsigned warnings;
+    unsigned gaggedErrors;
+    int stopped;                // !=0 if the job was stopped by fatal()
+    jmp_buf *stop;              // where fatal() leaves the job, if not NULL
+
+    MessageSink();
+    ~MessageSink();
+    void flush();
+
+    static MessageSink *current();
+    static void setCurrent(MessageSink *sink);
+};
+
+void vmessage(Loc loc, const char *header, const char *format, va_list ap);
+
 struct Dsymbol;
 struct Library;
 struct File;
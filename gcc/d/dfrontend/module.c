@@ -36,6 +36,7 @@
 #include "dsymbol.h"
 #include "hdrgen.h"
 #include "lexer.h"
+#include "impcache.h"
 
 #ifdef IN_GCC
 #include "d-dmd-gcc.h"
@@ -49,6 +50,7 @@ Modules Module::amodules;
 
 Dsymbols Module::deferred; // deferred Dsymbol's needing semantic() run on them
 unsigned Module::dprogress;
+unsigned Module::deferredPasses;
 
 void Module::init()
 {
@@ -67,11 +69,13 @@ Module::Module(char *filename, Identifier *ident, int doDocComment, int doHdrGen
     md = NULL;
     errors = 0;
     numlines = 0;
+    srchash = 0;
     members = NULL;
     isDocFile = 0;
     needmoduleinfo = 0;
 #ifdef IN_GCC
     strictlyneedmoduleinfo = 0;
+    phaseTimes = NULL;
 #endif
     selfimports = 0;
     insearch = 0;
@@ -278,41 +282,7 @@ Module *Module::load(Loc loc, Identifiers *packages, Identifier *ident)
     m = new Module(filename, ident, 0, 0);
     m->loc = loc;
 
-    /* Search along global.path for .di file, then .d file.
-     */
-    char *result = NULL;
-    FileName *fdi = FileName::forceExt(filename, global.hdr_ext);
-    FileName *fd  = FileName::forceExt(filename, global.mars_ext);
-    char *sdi = fdi->toChars();
-    char *sd  = fd->toChars();
-
-    if (FileName::exists(sdi))
-        result = sdi;
-    else if (FileName::exists(sd))
-        result = sd;
-    else if (FileName::absolute(filename))
-        ;
-    else if (!global.path)
-        ;
-    else
-    {
-        for (size_t i = 0; i < global.path->dim; i++)
-        {
-            char *p = (*global.path)[i];
-            char *n = FileName::combine(p, sdi);
-            if (FileName::exists(n))
-            {   result = n;
-                break;
-            }
-            mem.free(n);
-            n = FileName::combine(p, sd);
-            if (FileName::exists(n))
-            {   result = n;
-                break;
-            }
-            mem.free(n);
-        }
-    }
+    char *result = findFile(filename);
     if (result)
         m->srcfile = new File(result);
 
@@ -341,10 +311,51 @@ Module *Module::load(Loc loc, Identifiers *packages, Identifier *ident)
     return m;
 }
 
+/*********************************
+ * Search along global.path for the .di file, then the .d file, of
+ * a module. filename is the module name as a path without extension.
+ * Returns:
+ *      path of the file, NULL if not found
+ */
+
+char *Module::findFile(char *filename)
+{
+    char *result = NULL;
+    FileName *fdi = FileName::forceExt(filename, global.hdr_ext);
+    FileName *fd  = FileName::forceExt(filename, global.mars_ext);
+    char *sdi = fdi->toChars();
+    char *sd  = fd->toChars();
+
+    if (ImportCache::exists("", sdi))
+        result = sdi;
+    else if (ImportCache::exists("", sd))
+        result = sd;
+    else if (FileName::absolute(filename))
+        ;
+    else if (!global.path)
+        ;
+    else
+    {
+        for (size_t i = 0; i < global.path->dim; i++)
+        {
+            char *p = (*global.path)[i];
+            if (ImportCache::exists(p, sdi))
+            {   result = FileName::combine(p, sdi);
+                break;
+            }
+            if (ImportCache::exists(p, sd))
+            {   result = FileName::combine(p, sd);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
 bool Module::read(Loc loc)
 {
     //printf("Module::read('%s') file '%s'\n", toChars(), srcfile->toChars());
-    if (srcfile->read())
+    if (srcfile->mmread())
     {   error(loc, "is in file '%s' which cannot be read", srcfile->toChars());
         if (!global.gag)
         {   /* Print path
@@ -401,6 +412,23 @@ inline unsigned readlongBE(unsigned *p)
 }
 
 void Module::parse()
+{
+    parseSource();
+    if (!isDocFile)
+        declareModule();
+}
+
+/**************************************
+ * Lex and parse the contents of srcfile into members.
+ * Can be run for several root modules at once: the state shared with
+ * other modules is the identifier table and the __DATE__ strings,
+ * which are locked, the numbers of the identifiers made up by
+ * Lexer::uniqueId() and Identifier::generateId(), which are counted
+ * per thread, and the messages, which go to the MessageSink of the
+ * thread, see fatal().  The shared basic types are only read.
+ */
+
+void Module::parseSource()
 {   char *srcname;
     unsigned char *buf;
     unsigned buflen;
@@ -598,13 +626,20 @@ void Module::parse()
     p.nextToken();
     members = p.parseModule();
 
-    ::free(srcfile->buffer);
-    srcfile->buffer = NULL;
-    srcfile->len = 0;
+    srchash = String::calcHash((char *)buf, buflen);
+    srcfile->freeData();
 
     md = p.md;
     numlines = p.loc.linnum;
+}
 
+/**************************************
+ * Enter the parsed module into the package and module tables.
+ */
+
+void Module::declareModule()
+{
+    char *srcname = srcfile->name->toChars();
     DsymbolTable *dst;
 
     if (md)
@@ -997,6 +1032,7 @@ void Module::runDeferredSemantic()
         len = deferred.dim;
         if (!len)
             break;
+        deferredPasses++;
 
         Dsymbol **todo;
         Dsymbol *tmp;
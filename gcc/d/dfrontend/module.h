@@ -52,6 +52,7 @@ struct Module : Package
     static Modules amodules;            // array of all modules
     static Dsymbols deferred;   // deferred Dsymbol's needing semantic() run on them
     static unsigned dprogress;  // progress resolving the deferred list
+    static unsigned deferredPasses;     // passes made over the deferred list
     static void init();
 
     static ClassDeclaration *moduleinfo;
@@ -66,10 +67,12 @@ struct Module : Package
     File *docfile;      // output documentation file
     unsigned errors;    // if any errors in file
     unsigned numlines;  // number of lines in source file
+    hash_t srchash;     // hash of the source text
     int isDocFile;      // if it is a documentation input file, not D source
     int needmoduleinfo;
 #ifdef IN_GCC
     int strictlyneedmoduleinfo;
+    double *phaseTimes;         // wall time per phase, see -fd-time-report=
 #endif
 
     int selfimports;            // 0: don't know, 1: does not, 2: does
@@ -114,6 +117,7 @@ struct Module : Package
     ~Module();
 
     static Module *load(Loc loc, Identifiers *packages, Identifier *ident);
+    static char *findFile(char *filename);
 
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
     void toJsonBuffer(OutBuffer *buf);
@@ -121,6 +125,8 @@ struct Module : Package
     void setDocfile();  // set docfile member
     bool read(Loc loc); // read file, returns 'true' if succeed, 'false' otherwise.
     void parse();       // syntactic parse
+    void parseSource(); // parse() part that can run in parallel with other modules
+    void declareModule(); // parse() part adding module to global tables
     void importAll(Scope *sc);
     void semantic();    // semantic analysis
     void semantic2();   // pass 2 semantic analysis
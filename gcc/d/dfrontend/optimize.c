@@ -28,6 +28,7 @@
 #include "expression.h"
 #include "declaration.h"
 #include "aggregate.h"
+#include "ctfeprof.h"
 #include "init.h"
 
 
@@ -541,6 +542,7 @@ Expression *CallExp::optimize(int result)
             }
             else if (result & WANTinterpret)
             {
+                CtfeProfile::callsite = loc;
                 Expression *eresult = fd->interpret(NULL, arguments);
                 if (eresult && eresult != EXP_VOID_INTERPRET)
                     e = eresult;
@@ -554,6 +556,7 @@ Expression *CallExp::optimize(int result)
         FuncDeclaration *fd = dve->var->isFuncDeclaration();
         if (fd)
         {
+            CtfeProfile::callsite = loc;
             Expression *eresult = fd->interpret(NULL, arguments, dve->e1);
             if (eresult && eresult != EXP_VOID_INTERPRET)
                 e = eresult;
@@ -26,6 +26,12 @@
 
 Mem mem;
 
+/* Bytes requested through Mem and the global operator new.  This is
+ * counted per thread, threads running jobs for the main thread hand
+ * their count back to it when done.
+ */
+THREAD_LOCAL unsigned long long Mem::allocated;
+
 void Mem::init()
 {
 }
@@ -38,7 +44,9 @@ char *Mem::strdup(const char *s)
     {
         p = ::strdup(s);
         if (p)
+        {   allocated += strlen(s) + 1;
             return p;
+        }
         error();
     }
     return NULL;
@@ -54,6 +62,7 @@ void *Mem::malloc(size_t size)
         p = ::malloc(size);
         if (!p)
             error();
+        allocated += size;
     }
     return p;
 }
@@ -68,11 +77,15 @@ void *Mem::calloc(size_t size, size_t n)
         p = ::calloc(size, n);
         if (!p)
             error();
+        allocated += size * n;
     }
     return p;
 }
 
-void *Mem::realloc(void *p, size_t size)
+/* oldsize is the size p was allocated with, only the growth is added
+ * to allocated.
+ */
+void *Mem::realloc(void *p, size_t size, size_t oldsize)
 {
     if (!size)
     {   if (p)
@@ -85,6 +98,7 @@ void *Mem::realloc(void *p, size_t size)
         p = ::malloc(size);
         if (!p)
             error();
+        allocated += size;
     }
     else
     {
@@ -94,6 +108,8 @@ void *Mem::realloc(void *p, size_t size)
         {   free(psave);
             error();
         }
+        if (size > oldsize)
+            allocated += size - oldsize;
     }
     return p;
 }
@@ -116,6 +132,7 @@ void *Mem::mallocdup(void *o, size_t size)
             error();
         else
             memcpy(p,o,size);
+        allocated += size;
     }
     return p;
 }
@@ -150,7 +167,9 @@ void * operator new(size_t m_size)
 {
     void *p = malloc(m_size);
     if (p)
+    {   Mem::allocated += m_size;
         return p;
+    }
     printf("Error: out of memory\n");
     exit(EXIT_FAILURE);
     return p;
@@ -16,9 +16,19 @@ typedef void (*FINALIZERPROC)(void* pObj, void* pClientData);
 
 struct GC;                      // thread specific allocator
 
+/*** Thread local storage class ***/
+#ifndef THREAD_LOCAL
+#if _MSC_VER || __DMC__
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+#endif
+
 struct Mem
 {
     GC *gc;                     // pointer to our thread specific allocator
+    static THREAD_LOCAL unsigned long long allocated;   // bytes requested so far by this thread
     Mem() { gc = NULL; }
 
     void init();
@@ -36,7 +46,7 @@ struct Mem
     void *malloc(size_t size);
     void *malloc_uncollectable(size_t size);
     void *calloc(size_t size, size_t n);
-    void *realloc(void *p, size_t size);
+    void *realloc(void *p, size_t size, size_t oldsize);
     void free(void *p);
     void free_uncollectable(void *p);
     void *mallocdup(void *o, size_t size);
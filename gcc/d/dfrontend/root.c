@@ -49,6 +49,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <utime.h>
+#include <sys/mman.h>
 #endif
 
 //#include "port.h"
@@ -1066,6 +1067,17 @@ File::File(char *n)
 }
 
 File::~File()
+{
+    freeData();
+    if (touchtime)
+        mem.free(touchtime);
+}
+
+/*************************************
+ * Release buffer, whether it is owned or memory mapped.
+ */
+
+void File::freeData()
 {
     if (buffer)
     {
@@ -1074,10 +1086,14 @@ File::~File()
 #if _WIN32
         else if (ref == 2)
             UnmapViewOfFile(buffer);
+#else
+        else if (ref == 2)
+            munmap(buffer, len);
 #endif
     }
-    if (touchtime)
-        mem.free(touchtime);
+    buffer = NULL;
+    len = 0;
+    ref = 0;
 }
 
 void File::mark()
@@ -1109,9 +1125,7 @@ int File::read()
         goto err1;
     }
 
-    if (!ref)
-        ::free(buffer);
-    ref = 0;       // we own the buffer now
+    freeData();    // we own the buffer now
 
     //printf("\tfile opened\n");
     if (fstat(fd, &buf))
@@ -1173,9 +1187,7 @@ err1:
     if (h == INVALID_HANDLE_VALUE)
         goto err1;
 
-    if (!ref)
-        ::free(buffer);
-    ref = 0;
+    freeData();
 
     size = GetFileSize(h,NULL);
     buffer = (unsigned char *) ::malloc(size + 2);
@@ -1221,17 +1233,56 @@ err1:
 
 /*****************************
  * Read a file with memory mapped file I/O.
+ * Like read(), there are two 0 bytes past the end of the buffer
+ * as a sentinel for the scanner.  These come from the zero filled
+ * remainder of the last page, so if it has no room for them the
+ * file is read() instead.
  */
 
 int File::mmread()
 {
 #ifndef _WIN32
-    return read();
-#endif
-#if _WIN32
+    struct stat buf;
+    size_t size;
+    size_t pagesize;
+    void *p;
+    char *name;
+    int fd;
+
+    name = this->name->toChars();
+    fd = open(name, O_RDONLY);
+    if (fd == -1)
+        return 1;
+
+    if (fstat(fd, &buf))
+    {   close(fd);
+        return 1;
+    }
+    size = buf.st_size;
+    pagesize = sysconf(_SC_PAGESIZE);
+    if (size == 0 || size % pagesize == 0 || size % pagesize > pagesize - 2)
+    {   close(fd);
+        return read();
+    }
+
+    // Private writable mapping, so nothing can write back to the file
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return read();
+
+    freeData();
+    ref = 2;
+    buffer = (unsigned char *)p;
+    len = size;
+    if (touchtime)
+        memcpy(touchtime, &buf, sizeof(buf));
+    return 0;
+#elif _WIN32
     HANDLE hFile;
     HANDLE hFileMap;
     DWORD size;
+    SYSTEM_INFO si;
     char *name;
 
     name = this->name->toChars();
@@ -1243,6 +1294,12 @@ int File::mmread()
     size = GetFileSize(hFile, NULL);
     //printf(" file created, size %d\n", size);
 
+    GetSystemInfo(&si);
+    if (size == 0 || size % si.dwPageSize == 0 || size % si.dwPageSize > si.dwPageSize - 2)
+    {   CloseHandle(hFile);
+        return read();
+    }
+
     hFileMap = CreateFileMapping(hFile,NULL,PAGE_READONLY,0,size,NULL);
     if (CloseHandle(hFile) != TRUE)
         goto Lerr;
@@ -1252,10 +1309,9 @@ int File::mmread()
 
     //printf(" mapping created\n");
 
-    if (!ref)
-        mem.free(buffer);
+    freeData();
     ref = 2;
-    buffer = (unsigned char *)MapViewOfFileEx(hFileMap, FILE_MAP_READ,0,0,size,NULL);
+    buffer = (unsigned char *)MapViewOfFileEx(hFileMap, FILE_MAP_COPY,0,0,size,NULL);
     if (CloseHandle(hFileMap) != TRUE)
         goto Lerr;
     if (buffer == NULL)                 // mapping view failed
@@ -1599,8 +1655,9 @@ void OutBuffer::reserve(unsigned nbytes)
     //printf("OutBuffer::reserve: size = %d, offset = %d, nbytes = %d\n", size, offset, nbytes);
     if (size - offset < nbytes)
     {
+        unsigned oldsize = size;
         size = (offset + nbytes) * 2;
-        data = (unsigned char *)mem.realloc(data, size);
+        data = (unsigned char *)mem.realloc(data, size, oldsize);
     }
 }
 
@@ -2031,7 +2088,7 @@ void Bits::resize(unsigned bitdim)
     unsigned mask;
 
     allocdim = (bitdim + 31) / 32;
-    data = (unsigned *)mem.realloc(data, allocdim * sizeof(data[0]));
+    data = (unsigned *)mem.realloc(data, allocdim * sizeof(data[0]), this->allocdim * sizeof(data[0]));
     if (this->allocdim < allocdim)
         memset(data + this->allocdim, 0, (allocdim - this->allocdim) * sizeof(data[0]));
 
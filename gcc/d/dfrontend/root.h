@@ -194,6 +194,11 @@ struct File : Object
 
     char *toChars();
 
+    /* Free buffer, whether owned or memory mapped
+     */
+
+    void freeData();
+
     /* Read file, return !=0 if error
      */
 
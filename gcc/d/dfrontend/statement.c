@@ -1815,7 +1815,14 @@ Lagain:
                 increment = new AddAssignExp(loc, new VarExp(loc, key), new IntegerExp(1));
 
             // T value = tmp[key];
-            value->init = new ExpInitializer(loc, new IndexExp(loc, new VarExp(loc, tmp), new VarExp(loc, key)));
+            IndexExp *ix = new IndexExp(loc, new VarExp(loc, tmp), new VarExp(loc, key));
+            /* The condition was tested just before, and the body can't
+             * see tmp. foreach_reverse only knows this if the body can't
+             * change the key either.
+             */
+            if (op == TOKforeach || dim == 1)
+                ix->skipboundscheck = 1;
+            value->init = new ExpInitializer(loc, ix);
             Statement *ds = new ExpStatement(loc, value);
 
             body = new CompoundStatement(loc, ds, body);
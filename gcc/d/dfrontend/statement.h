@@ -50,11 +50,13 @@ struct DefaultStatement;
 struct LabelStatement;
 struct HdrGenState;
 struct InterState;
+struct CtfeCompiler;
 
 enum TOK;
 
 // Back end
 struct IRState;
+struct BoundsScan;
 struct Blockx;
 #ifdef IN_GCC
 union tree_node; typedef union tree_node block;
@@ -107,6 +109,7 @@ struct Statement : Object
     virtual Statement *scopeCode(Scope *sc, Statement **sentry, Statement **sexit, Statement **sfinally);
     virtual Statements *flatten(Scope *sc);
     virtual Expression *interpret(InterState *istate);
+    virtual int ctfeCompile(CtfeCompiler *cc);
     virtual Statement *last();
 
     virtual int inlineCost(InlineCostState *ics);
@@ -116,6 +119,7 @@ struct Statement : Object
 
     // Back end
     virtual void toIR(IRState *irs);
+    virtual void boundsScan(BoundsScan *bs);
 
     // Avoid dynamic_cast
     virtual ExpStatement *isExpStatement() { return NULL; }
@@ -145,6 +149,7 @@ struct ExpStatement : Statement
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
     Statement *semantic(Scope *sc);
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
     int blockExit(bool mustNotThrow);
     int isEmpty();
     Statement *scopeCode(Scope *sc, Statement **sentry, Statement **sexit, Statement **sfinally);
@@ -155,6 +160,7 @@ struct ExpStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 
     ExpStatement *isExpStatement() { return this; }
 };
@@ -200,6 +206,7 @@ struct CompoundStatement : Statement
     Statements *flatten(Scope *sc);
     ReturnStatement *isReturnStatement();
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
     Statement *last();
 
     int inlineCost(InlineCostState *ics);
@@ -208,6 +215,7 @@ struct CompoundStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 
     CompoundStatement *isCompoundStatement() { return this; }
 };
@@ -243,6 +251,7 @@ struct UnrolledLoopStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct ScopeStatement : Statement
@@ -261,6 +270,7 @@ struct ScopeStatement : Statement
     int comeFrom();
     int isEmpty();
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
 
     int inlineCost(InlineCostState *ics);
     Expression *doInline(InlineDoState *ids);
@@ -268,6 +278,7 @@ struct ScopeStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct WhileStatement : Statement
@@ -289,6 +300,7 @@ struct WhileStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct DoStatement : Statement
@@ -305,11 +317,13 @@ struct DoStatement : Statement
     int blockExit(bool mustNotThrow);
     int comeFrom();
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct ForStatement : Statement
@@ -331,6 +345,7 @@ struct ForStatement : Statement
     int blockExit(bool mustNotThrow);
     int comeFrom();
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
     int inlineCost(InlineCostState *ics);
@@ -338,6 +353,7 @@ struct ForStatement : Statement
     Statement *doInlineStatement(InlineDoState *ids);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct ForeachStatement : Statement
@@ -416,6 +432,7 @@ struct IfStatement : Statement
     Statement *syntaxCopy();
     Statement *semantic(Scope *sc);
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
     int usesEH();
     int blockExit(bool mustNotThrow);
@@ -427,6 +444,7 @@ struct IfStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct ConditionalStatement : Statement
@@ -460,6 +478,7 @@ struct PragmaStatement : Statement
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct StaticAssertStatement : Statement
@@ -499,6 +518,7 @@ struct SwitchStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct CaseStatement : Statement
@@ -523,6 +543,7 @@ struct CaseStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 #if DMDV2
@@ -561,6 +582,7 @@ struct DefaultStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct GotoDefaultStatement : Statement
@@ -575,6 +597,7 @@ struct GotoDefaultStatement : Statement
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct GotoCaseStatement : Statement
@@ -590,6 +613,7 @@ struct GotoCaseStatement : Statement
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct SwitchErrorStatement : Statement
@@ -599,6 +623,7 @@ struct SwitchErrorStatement : Statement
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct ReturnStatement : Statement
@@ -611,6 +636,7 @@ struct ReturnStatement : Statement
     Statement *semantic(Scope *sc);
     int blockExit(bool mustNotThrow);
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
 
     int inlineCost(InlineCostState *ics);
     Expression *doInline(InlineDoState *ids);
@@ -618,6 +644,7 @@ struct ReturnStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 
     ReturnStatement *isReturnStatement() { return this; }
 };
@@ -630,10 +657,17 @@ struct BreakStatement : Statement
     Statement *syntaxCopy();
     Statement *semantic(Scope *sc);
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
     int blockExit(bool mustNotThrow);
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
+#ifdef IN_GCC
+    int inlineCost(InlineCostState *ics);
+    Statement *doInlineStatement(InlineDoState *ids);
+#endif
+
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct ContinueStatement : Statement
@@ -644,10 +678,17 @@ struct ContinueStatement : Statement
     Statement *syntaxCopy();
     Statement *semantic(Scope *sc);
     Expression *interpret(InterState *istate);
+    int ctfeCompile(CtfeCompiler *cc);
     int blockExit(bool mustNotThrow);
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 
+#ifdef IN_GCC
+    int inlineCost(InlineCostState *ics);
+    Statement *doInlineStatement(InlineDoState *ids);
+#endif
+
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct SynchronizedStatement : Statement
@@ -670,6 +711,7 @@ struct SynchronizedStatement : Statement
     elem *esync;
     SynchronizedStatement(Loc loc, elem *esync, Statement *body);
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct WithStatement : Statement
@@ -689,6 +731,7 @@ struct WithStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct TryCatchStatement : Statement
@@ -707,6 +750,7 @@ struct TryCatchStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 };
 
@@ -744,6 +788,7 @@ struct TryFinallyStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct OnScopeStatement : Statement
@@ -761,6 +806,7 @@ struct OnScopeStatement : Statement
     Expression *interpret(InterState *istate);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct ThrowStatement : Statement
@@ -777,6 +823,7 @@ struct ThrowStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct VolatileStatement : Statement
@@ -793,6 +840,7 @@ struct VolatileStatement : Statement
     Statement *inlineScan(InlineScanState *iss);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct DebugStatement : Statement
@@ -819,6 +867,7 @@ struct GotoStatement : Statement
     Expression *interpret(InterState *istate);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
     void toCBuffer(OutBuffer *buf, HdrGenState *hgs);
 };
 
@@ -845,6 +894,7 @@ struct LabelStatement : Statement
     LabelStatement *isLabelStatement() { return this; }
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 struct LabelDsymbol : Dsymbol
@@ -898,6 +948,7 @@ struct ImportStatement : Statement
     Statement *doInlineStatement(InlineDoState *ids);
 
     void toIR(IRState *irs);
+    void boundsScan(BoundsScan *bs);
 };
 
 #ifdef IN_GCC
@@ -18,122 +18,193 @@
 #include "lstring.h"
 #include "stringtable.h"
 
-void StringTable::init(unsigned size)
+#define POOL_BITS 12
+#define POOL_SIZE (1U << POOL_BITS)
+
+struct StringEntry
+{
+    hash_t hash;
+    StringValue *value;         // NULL if slot is empty
+};
+
+/* Dchar::calcHash() does a poor job of spreading the low bits,
+ * which are all that's used when indexing the table.
+ */
+static inline hash_t mixHash(hash_t h)
 {
-    table = (void **)mem.calloc(size, sizeof(void *));
-    tabledim = size;
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    return h;
+}
+
+void StringTable::init(size_t size)
+{
+    tabledim = 32;
+    while (tabledim < size)
+        tabledim <<= 1;
+    table = (StringEntry *)mem.calloc(tabledim, sizeof(StringEntry));
+
+    pools = NULL;
+    npools = nfill = 0;
     count = 0;
 }
 
 StringTable::~StringTable()
 {
-    unsigned i;
-
-    // Zero out dangling pointers to help garbage collector.
-    // Should zero out StringEntry's too.
-    for (i = 0; i < count; i++)
-        table[i] = NULL;
+    for (size_t i = 0; i < npools; ++i)
+        mem.free(pools[i]);
 
     mem.free(table);
+    mem.free(pools);
     table = NULL;
+    pools = NULL;
 }
 
-struct StringEntry
+/****************************************
+ * Free all the entries and start over with an empty table.
+ */
+
+void StringTable::reset(size_t size)
 {
-    StringEntry *left;
-    StringEntry *right;
-    hash_t hash;
+    for (size_t i = 0; i < npools; ++i)
+        mem.free(pools[i]);
 
-    StringValue value;
+    mem.free(table);
+    mem.free(pools);
+    init(size);
+}
 
-    static StringEntry *alloc(const dchar *s, unsigned len);
-};
+/****************************************
+ * Allocate a new StringValue for s[0..len] out of the pools.
+ */
 
-StringEntry *StringEntry::alloc(const dchar *s, unsigned len)
+StringValue *StringTable::allocValue(const dchar *s, size_t len)
 {
-    StringEntry *se;
+    const size_t nbytes = (sizeof(StringValue) - sizeof(Lstring) + Lstring::size(len) +
+                           sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    StringValue *sv;
+    if (nbytes > POOL_SIZE)
+    {   // Too big for a pool, give it one of its own
+        pools = (void **)mem.realloc(pools, (npools + 1) * sizeof(pools[0]), npools * sizeof(pools[0]));
+        npools++;
+        pools[npools - 1] = mem.calloc(1, nbytes);
+        sv = (StringValue *)pools[npools - 1];
+        // Put it before the current pool so that pool can still be filled
+        if (npools > 1)
+        {   void *tmp = pools[npools - 1];
+            pools[npools - 1] = pools[npools - 2];
+            pools[npools - 2] = tmp;
+        }
+        else
+            nfill = POOL_SIZE;
+    }
+    else
+    {
+        if (!npools || nfill + nbytes > POOL_SIZE)
+        {
+            pools = (void **)mem.realloc(pools, (npools + 1) * sizeof(pools[0]), npools * sizeof(pools[0]));
+            npools++;
+            pools[npools - 1] = mem.calloc(1, POOL_SIZE);
+            nfill = 0;
+        }
+        sv = (StringValue *)((char *)pools[npools - 1] + nfill);
+        nfill += nbytes;
+    }
 
-    se = (StringEntry *) mem.calloc(1,sizeof(StringEntry) - sizeof(Lstring) + Lstring::size(len));
-    se->value.lstring.length = len;
-    se->hash = Dchar::calcHash(s,len);
-    memcpy(se->value.lstring.string, s, len * sizeof(dchar));
-    return se;
+    sv->lstring.length = len;
+    memcpy(sv->lstring.string, s, len * sizeof(dchar));
+    sv->lstring.string[len] = 0;
+    return sv;
 }
 
-void **StringTable::search(const dchar *s, unsigned len)
+/****************************************
+ * Return index of the slot holding s[0..len], or of the
+ * empty slot where it should be inserted.
+ */
+
+size_t StringTable::findSlot(hash_t hash, const dchar *s, size_t len)
 {
-    hash_t hash;
-    unsigned u;
-    int cmp;
-    StringEntry **se;
-
-    //printf("StringTable::search(%p,%d)\n",s,len);
-    hash = Dchar::calcHash(s,len);
-    u = hash % tabledim;
-    se = (StringEntry **)&table[u];
-    //printf("\thash = %d, u = %d\n",hash,u);
-    while (*se)
+    // quadratic probing using triangular numbers visits
+    // every slot of a power of 2 sized table
+    for (size_t i = mixHash(hash) & (tabledim - 1), j = 1; ; ++j)
     {
-        cmp = (*se)->hash - hash;
-        if (cmp == 0)
+        StringValue *sv = table[i].value;
+        if (!sv ||
+            (table[i].hash == hash &&
+             sv->lstring.length == len &&
+             Dchar::memcmp(s, sv->lstring.string, len) == 0))
+            return i;
+        i = (i + j) & (tabledim - 1);
+    }
+}
+
+/****************************************
+ * Double the size of the table and rehash the entries.
+ * The hashes are cached so the strings don't need to be looked at.
+ */
+
+void StringTable::grow()
+{
+    const size_t odim = tabledim;
+    StringEntry *otab = table;
+    tabledim *= 2;
+    table = (StringEntry *)mem.calloc(tabledim, sizeof(StringEntry));
+
+    for (size_t i = 0; i < odim; ++i)
+    {   StringEntry *se = &otab[i];
+        if (!se->value)
+            continue;
+        for (size_t k = mixHash(se->hash) & (tabledim - 1), j = 1; ; ++j)
         {
-            cmp = (*se)->value.lstring.len() - len;
-            if (cmp == 0)
-            {
-                cmp = Dchar::memcmp(s,(*se)->value.lstring.toDchars(),len);
-                if (cmp == 0)
-                    break;
+            if (!table[k].value)
+            {   table[k] = *se;
+                break;
             }
+            k = (k + j) & (tabledim - 1);
         }
-        if (cmp < 0)
-            se = &(*se)->left;
-        else
-            se = &(*se)->right;
     }
-    //printf("\treturn %p, %p\n",se, (*se));
-    return (void **)se;
+    mem.free(otab);
 }
 
-StringValue *StringTable::lookup(const dchar *s, unsigned len)
-{   StringEntry *se;
-
-    se = *(StringEntry **)search(s,len);
-    if (se)
-        return &se->value;
-    else
-        return NULL;
+StringValue *StringTable::lookup(const dchar *s, size_t len)
+{
+    const hash_t hash = Dchar::calcHash(s, len);
+    const size_t i = findSlot(hash, s, len);
+    //printf("StringTable::lookup(%p,%d) = %d\n", s, len, i);
+    return table[i].value;
 }
 
-StringValue *StringTable::update(const dchar *s, unsigned len)
-{   StringEntry **pse;
-    StringEntry *se;
-
-    pse = (StringEntry **)search(s,len);
-    se = *pse;
-    if (!se)                    // not in table: so create new entry
+StringValue *StringTable::update(const dchar *s, size_t len)
+{
+    const hash_t hash = Dchar::calcHash(s, len);
+    size_t i = findSlot(hash, s, len);
+    if (!table[i].value)        // not in table: so create new entry
     {
-        se = StringEntry::alloc(s, len);
-        *pse = se;
+        if (++count > tabledim / 2)
+        {   // keep the load factor under 1/2
+            grow();
+            i = findSlot(hash, s, len);
+        }
+        table[i].hash = hash;
+        table[i].value = allocValue(s, len);
     }
-    return &se->value;
+    return table[i].value;
 }
 
-StringValue *StringTable::insert(const dchar *s, unsigned len)
-{   StringEntry **pse;
-    StringEntry *se;
-
-    pse = (StringEntry **)search(s,len);
-    se = *pse;
-    if (se)
+StringValue *StringTable::insert(const dchar *s, size_t len)
+{
+    const hash_t hash = Dchar::calcHash(s, len);
+    size_t i = findSlot(hash, s, len);
+    if (table[i].value)
         return NULL;            // error: already in table
-    else
-    {
-        se = StringEntry::alloc(s, len);
-        *pse = se;
+    if (++count > tabledim / 2)
+    {   // keep the load factor under 1/2
+        grow();
+        i = findSlot(hash, s, len);
     }
-    return &se->value;
+    table[i].hash = hash;
+    table[i].value = allocValue(s, len);
+    return table[i].value;
 }
-
-
-
-
@@ -28,21 +28,35 @@ struct StringValue
     Lstring lstring;
 };
 
+struct StringEntry;
+
+/* Open addressed hash table of strings, the StringValue's are allocated
+ * from pools and never move, so pointers to them stay valid as the table
+ * grows.
+ */
 struct StringTable
 {
-    void **table;
-    unsigned count;
-    unsigned tabledim;
+    StringEntry *table;
+    size_t tabledim;            // always a power of 2
+
+    void **pools;               // arena storage for the StringValue's
+    size_t npools;
+    size_t nfill;               // bytes used in the last pool
+
+    size_t count;
 
-    void init(unsigned size = 37);
+    void init(size_t size = 37);
+    void reset(size_t size = 37);
     ~StringTable();
 
-    StringValue *lookup(const dchar *s, unsigned len);
-    StringValue *insert(const dchar *s, unsigned len);
-    StringValue *update(const dchar *s, unsigned len);
+    StringValue *lookup(const dchar *s, size_t len);
+    StringValue *insert(const dchar *s, size_t len);
+    StringValue *update(const dchar *s, size_t len);
 
 private:
-    void **search(const dchar *s, unsigned len);
+    StringValue *allocValue(const dchar *s, size_t len);
+    size_t findSlot(hash_t hash, const dchar *s, size_t len);
+    void grow();
 };
 
 #endif
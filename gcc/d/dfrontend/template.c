@@ -290,6 +290,138 @@ int arrayObjectMatch(Objects *oa1, Objects *oa2, TemplateDeclaration *tempdecl,
     return 1;
 }
 
+/************************************
+ * Compute a hash of an Object that is consistent with match(),
+ * i.e. if match(o1, o2) then objectHash(o1) == objectHash(o2).
+ * Types are hashed by their merged deco, expressions by value,
+ * symbols by name and parent.
+ */
+
+static hash_t combineHash(hash_t h, hash_t v)
+{
+    return h * 37 + v;
+}
+
+static hash_t expressionHash(Expression *e)
+{
+    hash_t h = e->op;
+    switch (e->op)
+    {
+        case TOKint64:
+            h = combineHash(h, (hash_t)((IntegerExp *)e)->value);
+            break;
+
+        case TOKstring:
+        {   StringExp *se = (StringExp *)e;
+            h = combineHash(h, se->len);
+            for (size_t u = 0; u < se->len; u++)
+                h = combineHash(h, se->charAt(u));
+            break;
+        }
+
+        case TOKtuple:
+        {   TupleExp *te = (TupleExp *)e;
+            h = combineHash(h, te->exps->dim);
+            for (size_t i = 0; i < te->exps->dim; i++)
+                h = combineHash(h, expressionHash((*te->exps)[i]));
+            break;
+        }
+
+        case TOKvar:
+            h = combineHash(h, (hash_t)((VarExp *)e)->var);
+            break;
+
+        default:
+            /* Other expressions use equals() overrides that are not
+             * easily mirrored here, so only hash the op.
+             */
+            break;
+    }
+    return h;
+}
+
+static hash_t objectHash(Object *o)
+{
+    Type *t = isType(o);
+    Expression *e = isExpression(o);
+    Dsymbol *s = isDsymbol(o);
+    Tuple *u = isTuple(o);
+
+    if (s)
+    {   // Same manifest constant conversion as match()
+        VarDeclaration *v = s->isVarDeclaration();
+        if (v && v->storage_class & STCmanifest)
+        {   ExpInitializer *ei = v->init->isExpInitializer();
+            if (ei)
+                e = ei->exp, s = NULL;
+        }
+    }
+
+    if (t)
+    {   // deco strings are unique, see Type::equals()
+        return combineHash(1, t->deco ? (hash_t)t->deco : (hash_t)t);
+    }
+    else if (e)
+        return combineHash(2, expressionHash(e));
+    else if (s)
+    {   // match() compares the parents and, through Dsymbol::equals(),
+        // the identifiers by name
+        hash_t h = combineHash(3, (hash_t)s->parent);
+        return (s->ident) ? combineHash(h, s->ident->hashCode()) : h;
+    }
+    else if (u)
+    {
+        hash_t h = combineHash(4, u->objects.dim);
+        for (size_t i = 0; i < u->objects.dim; i++)
+            h = combineHash(h, objectHash(u->objects[i]));
+        return h;
+    }
+    return 0;
+}
+
+static hash_t arrayObjectHash(Objects *oa1)
+{
+    hash_t hash = 0;
+    for (size_t j = 0; j < oa1->dim; j++)
+        hash = combineHash(hash, objectHash((*oa1)[j]));
+    return hash;
+}
+
+/************************************
+ * Return 1 if any of the types in oa is a member of an instance of
+ * tempdecl which is currently being expanded in sc.  match() reports
+ * these and fakes a match, so such lookups compare against every
+ * instance as before, not only those in the hash bucket.
+ */
+
+static int isRecursiveExpansion(Objects *oa, TemplateDeclaration *tempdecl, Scope *sc)
+{
+    for (size_t j = 0; j < oa->dim; j++)
+    {   Object *o = (*oa)[j];
+        Type *t = isType(o);
+        Tuple *u = isTuple(o);
+
+        if (t)
+        {
+            Dsymbol *s = t->toDsymbol(sc);
+            if (s && s->parent)
+            {   TemplateInstance *ti1 = s->parent->isTemplateInstance();
+                if (ti1 && ti1->tempdecl == tempdecl)
+                {
+                    for (Scope *sc1 = sc; sc1; sc1 = sc1->enclosing)
+                    {
+                        if (sc1->scopesym == ti1)
+                            return 1;
+                    }
+                }
+            }
+        }
+        else if (u && isRecursiveExpansion(&u->objects, tempdecl, sc))
+            return 1;
+    }
+    return 0;
+}
+
 /****************************************
  * This makes a 'pretty' version of the template arguments.
  * It's analogous to genIdent() which makes a mangled version.
@@ -396,6 +528,7 @@ TemplateDeclaration::TemplateDeclaration(Loc loc, Identifier *id,
     this->literal = 0;
     this->ismixin = ismixin;
     this->previous = NULL;
+    this->instancesTable = NULL;
 
     // Compute in advance for Ddoc's use
     if (members)
@@ -605,6 +738,55 @@ int TemplateDeclaration::overloadInsert(Dsymbol *s)
     return TRUE;
 }
 
+/****************************
+ * Return the list of instances whose tdtypes hash to hash.
+ * If create, add an empty list if there isn't one yet.
+ */
+
+TemplateInstances *TemplateDeclaration::instanceBucket(hash_t hash, int create)
+{
+    if (!create)
+        return (TemplateInstances *)_aaGetRvalue(instancesTable, (Key)hash);
+
+    TemplateInstances **pbucket = (TemplateInstances **)_aaGet(&instancesTable, (Key)hash);
+    if (!*pbucket)
+        *pbucket = new TemplateInstances();
+    return *pbucket;
+}
+
+/****************************
+ * Add/remove a new instance of this template, ti->hash must be set.
+ */
+
+void TemplateDeclaration::addInstance(TemplateInstance *ti)
+{
+    instances.push(ti);
+    instanceBucket(ti->hash, 1)->push(ti);
+    TemplateStats::numInstances++;
+}
+
+void TemplateDeclaration::removeInstance(TemplateInstance *ti)
+{
+    for (size_t i = instances.dim; i-- > 0; )
+    {
+        if (instances[i] == ti)
+        {   instances.remove(i);
+            break;
+        }
+    }
+
+    TemplateInstances *bucket = instanceBucket(ti->hash, 0);
+    assert(bucket);
+    for (size_t i = bucket->dim; i-- > 0; )
+    {
+        if ((*bucket)[i] == ti)
+        {   bucket->remove(i);
+            break;
+        }
+    }
+    TemplateStats::numInstances--;
+}
+
 /****************************
  * Declare all the function parameters as variables
  * and add them to the scope
@@ -4284,6 +4466,7 @@ TemplateInstance::TemplateInstance(Loc loc, Identifier *ident)
     this->havetempdecl = 0;
     this->isnested = NULL;
     this->speculative = 0;
+    this->hash = 0;
 }
 
 /*****************
@@ -4315,6 +4498,7 @@ TemplateInstance::TemplateInstance(Loc loc, TemplateDeclaration *td, Objects *ti
     this->havetempdecl = 1;
     this->isnested = NULL;
     this->speculative = 0;
+    this->hash = 0;
 
     assert((size_t)tempdecl->scope > 0x10000);
 }
@@ -4519,24 +4703,39 @@ void TemplateInstance::semantic(Scope *sc, Expressions *fargs)
 
     /* See if there is an existing TemplateInstantiation that already
      * implements the typeargs. If so, just refer to that one instead.
+     * Only the instances whose tdtypes hash the same are candidates.
      */
+    hash = combineHash(arrayObjectHash(&tdtypes), (hash_t)isnested);
+    TemplateStats::numLookups++;
 
-    for (size_t i = 0; i < tempdecl->instances.dim; i++)
+    TemplateInstances *bucket;
+    int recursive = tempdecl->instances.dim && isRecursiveExpansion(&tdtypes, tempdecl, sc);
+    if (recursive)
+        bucket = &tempdecl->instances;
+    else
     {
-        TemplateInstance *ti = tempdecl->instances.tdata()[i];
+        bucket = tempdecl->instanceBucket(hash, 0);
+        if (bucket && bucket->dim > TemplateStats::maxChain)
+            TemplateStats::maxChain = bucket->dim;
+    }
+
+    for (size_t i = 0; bucket && i < bucket->dim; i++)
+    {
+        TemplateInstance *ti = (*bucket)[i];
 #if LOG
         printf("\t%s: checking for match with instance %d (%p): '%s'\n", toChars(), i, ti, ti->toChars());
 #endif
         assert(tdtypes.dim == ti->tdtypes.dim);
 
         // Nesting must match
-        if (isnested != ti->isnested)
+        if (isnested != ti->isnested || (!recursive && hash != ti->hash))
         {
             //printf("test2 isnested %s ti->isnested %s\n", isnested ? isnested->toChars() : "", ti->isnested ? ti->isnested->toChars() : "");
             continue;
         }
         //printf("parent = %s, ti->parent = %s\n", tempdecl->parent->toPrettyChars(), ti->parent->toPrettyChars());
 
+        TemplateStats::numCompares++;
         if (!arrayObjectMatch(&tdtypes, &ti->tdtypes, tempdecl, sc))
             goto L1;
 
@@ -4595,6 +4794,7 @@ void TemplateInstance::semantic(Scope *sc, Expressions *fargs)
 #if LOG
         printf("\tit's a match with instance %p, %d\n", inst, inst->semanticRun);
 #endif
+        TemplateStats::numHits++;
         return;
 
      L1:
@@ -4613,8 +4813,7 @@ void TemplateInstance::semantic(Scope *sc, Expressions *fargs)
     if (global.gag && sc->speculative)
         speculative = 1;
 
-    int tempdecl_instance_idx = tempdecl->instances.dim;
-    tempdecl->instances.push(this);
+    tempdecl->addInstance(this);
     parent = tempdecl->parent;
     //printf("parent = '%s'\n", parent->kind());
 
@@ -4888,7 +5087,7 @@ void TemplateInstance::semantic(Scope *sc, Expressions *fargs)
             // instance/symbol lists we added it to and reset our state to
             // finish clean and so we can try to instantiate it again later
             // (see bugzilla 4302 and 6602).
-            tempdecl->instances.remove(tempdecl_instance_idx);
+            tempdecl->removeInstance(this);
             if (target_symbol_list)
             {
                 // Because we added 'this' in the last position above, we
@@ -6402,3 +6601,16 @@ void TemplateMixin::toObjFile(int multiobj)
     TemplateInstance::toObjFile(multiobj);
 }
 
+/* ======================== TemplateStats =============================== */
+
+unsigned TemplateStats::numInstances;
+unsigned TemplateStats::numLookups;
+unsigned TemplateStats::numHits;
+unsigned TemplateStats::numCompares;
+unsigned TemplateStats::maxChain;
+
+void TemplateStats::print()
+{
+    fprintf(stdmsg, "template instances %u, lookups %u, hits %u, compares %u, max chain %u\n",
+        numInstances, numLookups, numHits, numCompares, maxChain);
+}
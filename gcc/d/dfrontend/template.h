@@ -54,6 +54,7 @@ struct TemplateDeclaration : ScopeDsymbol
     TemplateParameters *origParameters; // originals for Ddoc
     Expression *constraint;
     TemplateInstances instances;        // array of TemplateInstance's
+    AA *instancesTable;                 // hash of tdtypes => TemplateInstances*
 
     TemplateDeclaration *overnext;      // next overloaded TemplateDeclaration
     TemplateDeclaration *overroot;      // first in overnext list
@@ -100,6 +101,23 @@ struct TemplateDeclaration : ScopeDsymbol
     int isOverloadable();
 
     void makeParamNamesVisibleInConstraint(Scope *paramscope, Expressions *fargs);
+
+    TemplateInstances *instanceBucket(hash_t hash, int create);
+    void addInstance(TemplateInstance *ti);
+    void removeInstance(TemplateInstance *ti);
+};
+
+/* Statistics on looking up existing template instances, shown with -v
+ */
+struct TemplateStats
+{
+    static unsigned numInstances;       // instances added
+    static unsigned numLookups;         // lookups for an existing instance
+    static unsigned numHits;            // lookups that found an instance
+    static unsigned numCompares;        // arrayObjectMatch() calls done
+    static unsigned maxChain;           // longest bucket walked
+
+    static void print();
 };
 
 struct TemplateParameter
@@ -296,6 +314,7 @@ struct TemplateInstance : ScopeDsymbol
     int havetempdecl;   // 1 if used second constructor
     Dsymbol *isnested;  // if referencing local symbols, this is the context
     int speculative;    // 1 if only instantiated with errors gagged
+    hash_t hash;        // hash of tdtypes, key into tempdecl->instancesTable
 #ifdef IN_GCC
     /* On some targets, it is necessary to know whether a symbol
        will be emitted in the output or not before the symbol